@@ -0,0 +1,289 @@
+/*
+ * Auto-player enumerating the placements of a piece with vector row operations
+ *
+ * The well is a bitboard of 10-bit rows. The 16 lanes of a vector hold a
+ * rotated piece at each of the 16 column shifts of the 16-bit lines of
+ * tetris.c, walls included. Each rotation is dropped from the spawn row in all
+ * lanes at once. The well with the piece locked is then scanned from the top
+ * in all lanes for cleared lines, aggregate height, holes and bumpiness,
+ * weighted as in the well known heuristic of Yiyuan Lee. A placement is
+ * reachable when the piece fits at the spawn row on the way to its column.
+ * The best one is played through game_step() with rotate, shift and hard
+ * drop pushes. After each hard drop the well is checked against a plain C
+ * drop and line clear, which soak-tests the game logic. Games are seeded from
+ * -s on and played until -p pieces have locked.
+ *
+ * Usage: autoplay [-p pieces] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "tetris.h"
+
+#define LANES    16
+#define SPAWN_X  (WELL_MAX - 3)
+#define SPAWN_Y  3
+#define FULL_ROW (0x3FF << PIECE_MARGIN)
+// Pushes tried to reach a placement before the piece is dropped where it is
+#define MAX_MOVES 8
+
+// Lanes of rows and of masks with all bits set in the selected lanes
+typedef uint16_t vrow_t __attribute__((vector_size(LANES * sizeof(uint16_t))));
+
+typedef struct {
+	uint8_t rotate;
+	int8_t y;
+	float score;
+} placement_t;
+
+// Lines of each rotated piece at the column shift of each lane, lane l is
+// column y = l - PIECE_MARGIN, and the lanes where it is inside the walls
+static vrow_t laneLines[28][4];
+static vrow_t laneValid[28];
+static uint64_t placements;
+
+static void initLanes(void) {
+	uint8_t p, i, l;
+	uint32_t line, all;
+
+	for (p = 0; p < 28; p++) {
+		for (l = 0; l < LANES; l++) {
+			all = 0;
+			for (i = 0; i < 4; i++) {
+				line = ((pieces[p] >> (i * 4)) & 0xF) << l;
+				laneLines[p][i][l] = line;
+				all |= line;
+			}
+			laneValid[p][l] = (all & (WALLS | 0xFFFF0000)) ? 0 : 0xFFFF;
+		}
+	}
+}
+
+static inline vrow_t popcount(vrow_t v) {
+	v = v - ((v >> 1) & 0x5555);
+	v = (v & 0x3333) + ((v >> 2) & 0x3333);
+	v = (v + (v >> 4)) & 0x0F0F;
+	return (v + (v >> 8)) & 0x1F;
+}
+
+// Mask of the lanes that are zero. Vector compares are avoided, as they are
+// split into single lanes when the vector is wider than the SIMD registers
+static inline vrow_t isZero(vrow_t v) {
+	return ((v | -v) >> 15) - 1;
+}
+
+static inline bool any(vrow_t m) {
+	uint64_t q[sizeof(m) / 8];
+
+	memcpy(q, &m, sizeof(m));
+	return q[0] | q[1] | q[2] | q[3];
+}
+
+// Lanes where the lines at row x overlap blocks, the floor or the walls
+static inline vrow_t collide(const uint16_t *well, const vrow_t *lines, int8_t x) {
+	vrow_t c = {0};
+	uint8_t i;
+
+	for (i = 0; i < 4; i++, x++) {
+		// Rows above the well are empty
+		if (x >= WELL_MAX)
+			break;
+		c |= (x < 0) ? lines[i] : lines[i] & (uint16_t)(well[x] << PIECE_MARGIN);
+	}
+	return ~isZero(c);
+}
+
+// Score each lane of a rotation landed at row land of its lane
+static void evaluate(const uint16_t *well, const vrow_t *lines, vrow_t land, vrow_t reach,
+	uint8_t rotate, placement_t *best) {
+	vrow_t row, d, full, keep, seen = {0}, height = {0}, holes = {0}, bump = {0}, cleared = {0};
+	int8_t x;
+	uint8_t i, l;
+	float score;
+
+	for (x = WELL_MAX - 1; x >= 0; x--) {
+		d = (uint16_t)x - land;
+		row = (vrow_t){0} + (uint16_t)(well[x] << PIECE_MARGIN);
+		for (i = 0; i < 4; i++)
+			row |= lines[i] & isZero(d ^ i);
+		// Cleared rows are left out, as if the rows above had moved down
+		full = isZero(row ^ FULL_ROW);
+		cleared -= full;
+		keep = ~full;
+		seen |= row & keep;
+		height += popcount(seen) & keep;
+		holes += popcount(seen & ~row) & keep;
+		bump += popcount((seen ^ (seen >> 1)) & 0x1FF0) & keep;
+	}
+	for (l = 0; l < LANES; l++) {
+		if (!reach[l])
+			continue;
+		placements++;
+		score = -0.510066f * height[l] + 0.760666f * cleared[l] - 0.35663f * holes[l] - 0.184483f * bump[l];
+		if (score > best->score) {
+			best->score = score;
+			best->rotate = rotate;
+			best->y = l - PIECE_MARGIN;
+		}
+	}
+}
+
+// Best reachable placement of the piece, returns false when there is none
+static bool enumerate(const uint16_t *well, uint8_t piece, placement_t *best) {
+	uint8_t r, k, p;
+	int8_t l, x;
+	vrow_t fits, reach, falling, land;
+	const vrow_t *lines;
+
+	best->score = -1e30f;
+	for (r = 0; r < 4; r++) {
+		p = piece * 4 + r;
+		// Skip rotations with the same shape as an earlier one
+		for (k = 0; k < r && pieces[p] != pieces[piece * 4 + k]; k++);
+		if (k < r)
+			continue;
+		lines = laneLines[p];
+		fits = laneValid[p] & ~collide(well, lines, SPAWN_X);
+		// Lanes connected to the spawn column through lanes that fit
+		reach = (vrow_t){0};
+		for (l = SPAWN_Y + PIECE_MARGIN; l < LANES && fits[l]; l++)
+			reach[l] = 0xFFFF;
+		for (l = SPAWN_Y + PIECE_MARGIN - 1; l >= 0 && fits[l]; l--)
+			reach[l] = 0xFFFF;
+		if (!any(reach))
+			continue;
+		// Drop all lanes at once until each one collides, rows below the floor
+		// wrap around in the lanes
+		land = (vrow_t){0} + SPAWN_X;
+		falling = reach;
+		for (x = SPAWN_X - 1; any(falling); x--) {
+			falling &= ~collide(well, lines, x);
+			land = (land & ~falling) | (((vrow_t){0} + (uint16_t)x) & falling);
+		}
+		evaluate(well, lines, land, reach, r, best);
+	}
+	return best->score > -1e30f;
+}
+
+// Plain C drop and line clear of the current piece, returns the lines cleared
+static uint8_t reference(const game_t *g, uint16_t *well) {
+	uint16_t lines[4], bits = pieces[g->piece * 4 + g->rotate];
+	int8_t x = g->pieceX, r, w;
+	uint8_t i, n = 0;
+	bool fits;
+
+	memcpy(well, g->well, sizeof(g->well));
+	for (i = 0; i < 4; i++)
+		lines[i] = ((bits >> (i * 4)) & 0xF) << (g->pieceY + PIECE_MARGIN) >> PIECE_MARGIN;
+	do {
+		x--;
+		fits = true;
+		for (i = 0; i < 4; i++) {
+			if (lines[i] && (x + i < 0 || (x + i < WELL_MAX && well[x + i] & lines[i])))
+				fits = false;
+		}
+	} while (fits);
+	x++;
+	for (i = 0; i < 4; i++) {
+		if (lines[i] && x + i >= 0 && x + i < WELL_MAX)
+			well[x + i] |= lines[i];
+	}
+	for (r = w = 0; r < WELL_MAX; r++) {
+		if (well[r] == 0x3FF)
+			n++;
+		else
+			well[w++] = well[r];
+	}
+	while (w < WELL_MAX)
+		well[w++] = 0;
+	return n;
+}
+
+static double now(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv) {
+	game_t game;
+	placement_t target = {0, 0, 0};
+	uint16_t expected[WELL_MAX], seed = 1;
+	uint8_t pushed, result, moves = 0, cleared = 0;
+	uint32_t maxPieces = 1000000, pieces = 0, games = 0, dropped = 0, mismatches = 0;
+	uint64_t lines = 0;
+	bool planned = false, check;
+	double start, searchTime = 0, t;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:s:")) != -1) {
+		switch (opt) {
+			case 'p': maxPieces = strtoul(optarg, NULL, 0); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: %s [-p pieces] [-s seed]\n", argv[0]);
+				return 2;
+		}
+	}
+	initLanes();
+	game_init(&game, seed ? seed : 1);
+	start = now();
+	while (pieces < maxPieces) {
+		if (!planned) {
+			t = now();
+			if (!enumerate(game.well, game.piece, &target)) {
+				target.rotate = game.rotate;
+				target.y = game.pieceY;
+			}
+			searchTime += now() - t;
+			planned = true;
+			moves = 0;
+		}
+		// Rotate, then shift to the column, then hard drop
+		pushed = 0;
+		if (game.rotate != target.rotate)
+			pushed = BUTTON_UP;
+		else if (game.pieceY < target.y)
+			pushed = BUTTON_RIGHT;
+		else if (game.pieceY > target.y)
+			pushed = BUTTON_LEFT;
+		if (pushed && ++moves > MAX_MOVES)
+			pushed = 0;
+		check = !pushed;
+		if (check) {
+			pushed = BUTTON_B;
+			cleared = reference(&game, expected);
+		}
+		result = game_step(&game, GAME_INPUT(0, pushed));
+		if (check) {
+			if (memcmp(expected, game.well, sizeof(expected))) {
+				if (!mismatches)
+					printf("First mismatch at piece %u\n", pieces);
+				mismatches++;
+			}
+			lines += cleared;
+		} else if (result & GAME_LOCKED)
+			dropped++;	// Locked by gravity before reaching the placement
+		if (check || result & GAME_LOCKED) {
+			pieces++;
+			planned = false;
+		}
+		if (result & GAME_OVER) {
+			games++;
+			if (++seed == 0)
+				seed = 1;
+			game_init(&game, seed);
+			planned = false;
+		}
+	}
+	t = now() - start;
+	printf("%u pieces in %u games, %llu lines, %u mismatches, %u not placed\n", pieces, games,
+		(unsigned long long)lines, mismatches, dropped);
+	printf("%llu placements in %.3f s, %.0f placements/s, %.0f pieces/s played\n",
+		(unsigned long long)placements, searchTime, placements / searchTime, pieces / t);
+	return (mismatches) ? 1 : 0;
+}
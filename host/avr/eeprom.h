@@ -0,0 +1,36 @@
+/*
+ * Host stand-in for the EEPROM access of avr-libc
+ *
+ * EEMEM variables are collected in the eeprom section, so the section is
+ * the EEPROM and its offsets are the EEPROM addresses. A write takes the
+ * programming time of the ATtiny45 before the next access can start.
+ */
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM __attribute__((section("eeprom")))
+
+extern bool host_eeprom_ready(void);
+
+#define eeprom_is_ready() host_eeprom_ready()
+#define eeprom_busy_wait() do { } while (!eeprom_is_ready())
+
+extern uint8_t eeprom_read_byte(const uint8_t *p);
+extern uint16_t eeprom_read_word(const uint16_t *p);
+extern uint32_t eeprom_read_dword(const uint32_t *p);
+extern void eeprom_read_block(void *dst, const void *src, size_t n);
+extern void eeprom_write_byte(uint8_t *p, uint8_t value);
+extern void eeprom_write_word(uint16_t *p, uint16_t value);
+extern void eeprom_write_dword(uint32_t *p, uint32_t value);
+extern void eeprom_write_block(const void *src, void *dst, size_t n);
+extern void eeprom_update_byte(uint8_t *p, uint8_t value);
+extern void eeprom_update_word(uint16_t *p, uint16_t value);
+extern void eeprom_update_dword(uint32_t *p, uint32_t value);
+extern void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#endif /* HOST_AVR_EEPROM_H_ */
@@ -0,0 +1,36 @@
+/*
+ * Host stand-in for the interrupt definitions of avr-libc
+ *
+ * Vectors keep their avr-libc names, so the host model calls the handlers
+ * of the firmware when their flag and enable bits are set.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+extern void host_sei(void);
+
+#define sei() host_sei()
+#define cli() (SREG &= ~_BV(SREG_I))
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+#define EMPTY_INTERRUPT(vector) void vector(void); void vector(void) {}
+
+#define INT0_vect         __vector_1
+#define PCINT0_vect       __vector_2
+#define TIMER1_COMPA_vect __vector_3
+#define TIMER1_OVF_vect   __vector_4
+#define TIMER0_OVF_vect   __vector_5
+#define EE_RDY_vect       __vector_6
+#define ANA_COMP_vect     __vector_7
+#define ADC_vect          __vector_8
+#define TIMER1_COMPB_vect __vector_9
+#define TIMER0_COMPA_vect __vector_10
+#define TIMER0_COMPB_vect __vector_11
+#define WDT_vect          __vector_12
+#define USI_START_vect    __vector_13
+#define USI_OVF_vect      __vector_14
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
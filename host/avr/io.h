@@ -0,0 +1,211 @@
+/*
+ * Host stand-in for the ATtiny45 register definitions of avr-libc
+ *
+ * The I/O registers are bytes of an array at their ATtiny45 I/O addresses.
+ * PINB is computed from the button matrix model on every read, EEDR reads
+ * the EEPROM byte at EEAR after a read strobe.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+#include <avr/sfr_defs.h>
+
+extern volatile uint8_t hostIo[0x40];
+extern volatile uint8_t *host_pinb(void);
+extern volatile uint8_t *host_eedr(void);
+
+#define _SFR_IO8(addr)  (hostIo[addr])
+#define _SFR_IO16(addr) (*(volatile uint16_t *)&hostIo[addr])
+
+#define ADCSRB _SFR_IO8(0x03)
+#define ADCL   _SFR_IO8(0x04)
+#define ADCH   _SFR_IO8(0x05)
+#define ADCSRA _SFR_IO8(0x06)
+#define ADMUX  _SFR_IO8(0x07)
+#define ACSR   _SFR_IO8(0x08)
+#define USICR  _SFR_IO8(0x0D)
+#define USISR  _SFR_IO8(0x0E)
+#define USIDR  _SFR_IO8(0x0F)
+#define USIBR  _SFR_IO8(0x10)
+#define GPIOR0 _SFR_IO8(0x11)
+#define GPIOR1 _SFR_IO8(0x12)
+#define GPIOR2 _SFR_IO8(0x13)
+#define DIDR0  _SFR_IO8(0x14)
+#define PCMSK  _SFR_IO8(0x15)
+#define PINB   (*host_pinb())
+#define DDRB   _SFR_IO8(0x17)
+#define PORTB  _SFR_IO8(0x18)
+#define EECR   _SFR_IO8(0x1C)
+#define EEDR   (*host_eedr())
+#define EEAR   _SFR_IO16(0x1E)
+#define EEARL  _SFR_IO8(0x1E)
+#define EEARH  _SFR_IO8(0x1F)
+#define PRR    _SFR_IO8(0x20)
+#define WDTCR  _SFR_IO8(0x21)
+#define DWDR   _SFR_IO8(0x22)
+#define DTPS1  _SFR_IO8(0x23)
+#define DT1B   _SFR_IO8(0x24)
+#define DT1A   _SFR_IO8(0x25)
+#define CLKPR  _SFR_IO8(0x26)
+#define PLLCSR _SFR_IO8(0x27)
+#define OCR0B  _SFR_IO8(0x28)
+#define OCR0A  _SFR_IO8(0x29)
+#define TCCR0A _SFR_IO8(0x2A)
+#define OCR1B  _SFR_IO8(0x2B)
+#define GTCCR  _SFR_IO8(0x2C)
+#define OCR1C  _SFR_IO8(0x2D)
+#define OCR1A  _SFR_IO8(0x2E)
+#define TCNT1  _SFR_IO8(0x2F)
+#define TCCR1  _SFR_IO8(0x30)
+#define OSCCAL _SFR_IO8(0x31)
+#define TCNT0  _SFR_IO8(0x32)
+#define TCCR0B _SFR_IO8(0x33)
+#define MCUSR  _SFR_IO8(0x34)
+#define MCUCR  _SFR_IO8(0x35)
+#define SPMCSR _SFR_IO8(0x37)
+#define TIFR   _SFR_IO8(0x38)
+#define TIMSK  _SFR_IO8(0x39)
+#define GIFR   _SFR_IO8(0x3A)
+#define GIMSK  _SFR_IO8(0x3B)
+#define SREG   _SFR_IO8(0x3F)
+
+// PORTB, DDRB, PINB
+#define PB5 5
+#define PB4 4
+#define PB3 3
+#define PB2 2
+#define PB1 1
+#define PB0 0
+
+// USICR
+#define USISIE 7
+#define USIOIE 6
+#define USIWM1 5
+#define USIWM0 4
+#define USICS1 3
+#define USICS0 2
+#define USICLK 1
+#define USITC  0
+
+// USISR
+#define USISIF  7
+#define USIOIF  6
+#define USIPF   5
+#define USIDC   4
+#define USICNT3 3
+#define USICNT2 2
+#define USICNT1 1
+#define USICNT0 0
+
+// EECR
+#define EEPM1 5
+#define EEPM0 4
+#define EERIE 3
+#define EEMPE 2
+#define EEPE  1
+#define EERE  0
+
+// PRR
+#define PRTIM1 3
+#define PRTIM0 2
+#define PRUSI  1
+#define PRADC  0
+
+// WDTCR
+#define WDIF 7
+#define WDIE 6
+#define WDP3 5
+#define WDCE 4
+#define WDE  3
+#define WDP2 2
+#define WDP1 1
+#define WDP0 0
+
+// PLLCSR
+#define LSM   7
+#define PCKE  2
+#define PLLE  1
+#define PLOCK 0
+
+// TCCR0A
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01  1
+#define WGM00  0
+
+// GTCCR
+#define TSM    7
+#define PWM1B  6
+#define COM1B1 5
+#define COM1B0 4
+#define FOC1B  3
+#define FOC1A  2
+#define PSR1   1
+#define PSR0   0
+
+// TCCR1
+#define CTC1   7
+#define PWM1A  6
+#define COM1A1 5
+#define COM1A0 4
+#define CS13   3
+#define CS12   2
+#define CS11   1
+#define CS10   0
+
+// TCCR0B
+#define FOC0A 7
+#define FOC0B 6
+#define WGM02 3
+#define CS02  2
+#define CS01  1
+#define CS00  0
+
+// MCUSR
+#define WDRF  3
+#define BORF  2
+#define EXTRF 1
+#define PORF  0
+
+// MCUCR
+#define BODS  7
+#define PUD   6
+#define SE    5
+#define SM1   4
+#define SM0   3
+#define BODSE 2
+#define ISC01 1
+#define ISC00 0
+
+// TIFR
+#define OCF1A 6
+#define OCF1B 5
+#define OCF0A 4
+#define OCF0B 3
+#define TOV1  2
+#define TOV0  1
+
+// TIMSK
+#define OCIE1A 6
+#define OCIE1B 5
+#define OCIE0A 4
+#define OCIE0B 3
+#define TOIE1  2
+#define TOIE0  1
+
+// GIMSK
+#define INT0 6
+#define PCIE 5
+
+// SREG
+#define SREG_I 7
+
+#define RAMEND 0x25F
+#define E2END  0xFF
+#define FLASHEND 0xFFF
+
+#endif /* HOST_AVR_IO_H_ */
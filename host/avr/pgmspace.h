@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for the program memory access of avr-libc
+ *
+ * Program memory is ordinary memory on the host.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define memcpy_P(dest, src, n) memcpy(dest, src, n)
+#define strlen_P(s) strlen(s)
+#define strcpy_P(dest, src) strcpy(dest, src)
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
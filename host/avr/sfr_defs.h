@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for the bit helpers of avr-libc
+ */
+
+#ifndef HOST_AVR_SFR_DEFS_H_
+#define HOST_AVR_SFR_DEFS_H_
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_IO_ADDR(sfr) ((uint8_t)(&(sfr) - hostIo))
+#define bit_is_set(sfr, bit) ((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit) (!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit) do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+#endif /* HOST_AVR_SFR_DEFS_H_ */
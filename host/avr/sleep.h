@@ -0,0 +1,23 @@
+/*
+ * Host stand-in for the sleep definitions of avr-libc
+ */
+
+#ifndef HOST_AVR_SLEEP_H_
+#define HOST_AVR_SLEEP_H_
+
+#include <avr/io.h>
+
+extern void host_sleep(void);
+
+#define SLEEP_MODE_IDLE     0
+#define SLEEP_MODE_ADC      _BV(SM0)
+#define SLEEP_MODE_PWR_DOWN _BV(SM1)
+
+#define set_sleep_mode(mode) (MCUCR = (MCUCR & ~(_BV(SM0) | _BV(SM1))) | (mode))
+#define sleep_enable() (MCUCR |= _BV(SE))
+#define sleep_disable() (MCUCR &= ~_BV(SE))
+#define sleep_cpu() host_sleep()
+#define sleep_mode() do { sleep_enable(); sleep_cpu(); sleep_disable(); } while (0)
+#define sleep_bod_disable() (MCUCR |= _BV(BODS))
+
+#endif /* HOST_AVR_SLEEP_H_ */
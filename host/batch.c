@@ -0,0 +1,129 @@
+/*
+ * Plays many games at once on the reentrant game logic
+ *
+ * tetris.c is compiled with GAME_REENTRANT, so every thread steps its own
+ * games without the screen, the buttons and the timing of the firmware. Game
+ * n is seeded with n + 1 and played with random input as in input.c until
+ * the game is over or -m ticks have passed. The games are run on 1, 2, 4 and
+ * so on up to -j threads, all cores by default, and the games per second of
+ * each thread count are reported. The totals must be equal for all counts.
+ *
+ * Usage: batch [-n games] [-j threads] [-m ticks]
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "tetris.h"
+
+typedef struct {
+	uint64_t ticks, score, lines;
+} totals_t;
+
+static uint32_t games = 100000, maxTicks = 100000, nextGame;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static totals_t totals;
+
+static uint32_t inputRandom(uint32_t *seed) {
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7FFF;
+}
+
+// Release all buttons, push a single one or keep them
+static uint8_t randomButtons(uint32_t *seed, uint8_t held) {
+	if (inputRandom(seed) % 4 == 0)
+		return 0;
+	if (inputRandom(seed) % 3 == 0)
+		return 1 << (inputRandom(seed) % 6);
+	return held;
+}
+
+static void play(uint32_t n, totals_t *t) {
+	game_t game;
+	uint32_t seed = n + 1, tick;
+	uint8_t held = 0, last;
+
+	game_init(&game, n % 0xFFFF + 1);
+	for (tick = 0; tick < maxTicks; tick++) {
+		last = held;
+		held = randomButtons(&seed, held);
+		if (game_step(&game, GAME_INPUT(held, held & ~last)) & GAME_OVER)
+			break;
+	}
+	t->ticks += tick;
+#ifdef BCD_SCORE
+	t->score += bcdToBin(game.score);
+#else
+	t->score += game.score;
+#endif
+	t->lines += game.lines;
+}
+
+static void *worker(void *arg) {
+	totals_t t = {0, 0, 0};
+	uint32_t n;
+
+	(void)arg;
+	while ((n = __atomic_fetch_add(&nextGame, 1, __ATOMIC_RELAXED)) < games)
+		play(n, &t);
+	pthread_mutex_lock(&lock);
+	totals.ticks += t.ticks;
+	totals.score += t.score;
+	totals.lines += t.lines;
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+// Play all games on the number of threads, returns the seconds taken
+static double run(uint32_t threads) {
+	pthread_t id[threads];
+	struct timespec start, end;
+	uint32_t i;
+
+	nextGame = 0;
+	totals = (totals_t){0, 0, 0};
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < threads; i++) {
+		if (pthread_create(&id[i], NULL, worker, NULL)) {
+			perror("pthread_create");
+			exit(2);
+		}
+	}
+	for (i = 0; i < threads; i++)
+		pthread_join(id[i], NULL);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	return (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+int main(int argc, char **argv) {
+	uint32_t threads, maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+	double seconds, single = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:j:m:")) != -1) {
+		switch (opt) {
+			case 'n': games = strtoul(optarg, NULL, 0); break;
+			case 'j': maxThreads = strtoul(optarg, NULL, 0); break;
+			case 'm': maxTicks = strtoul(optarg, NULL, 0); break;
+			default:
+				fprintf(stderr, "Usage: %s [-n games] [-j threads] [-m ticks]\n", argv[0]);
+				return 2;
+		}
+	}
+	if (!maxThreads)
+		maxThreads = 1;
+	printf("%8s %10s %12s %8s  %s\n", "threads", "games/s", "ticks/s", "speedup", "ticks, score, lines");
+	for (threads = 1; ; threads = (threads * 2 < maxThreads) ? threads * 2 : maxThreads) {
+		seconds = run(threads);
+		if (threads == 1)
+			single = seconds;
+		printf("%8u %10.0f %12.0f %8.2f  %llu, %llu, %llu\n", threads, games / seconds,
+			totals.ticks / seconds, single / seconds, (unsigned long long)totals.ticks,
+			(unsigned long long)totals.score, (unsigned long long)totals.lines);
+		if (threads == maxThreads)
+			break;
+	}
+	return 0;
+}
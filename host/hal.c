@@ -0,0 +1,365 @@
+/*
+ * Host model of the ATtiny45 peripherals used by the firmware
+ *
+ * Timers 0 and 1 count in steps of their prescalers and set their compare and
+ * overflow flags. The compare flags of timer 1 are set as its counter leaves
+ * the compare value, so in CTC mode together with the clear. The watchdog
+ * wakes from power down after its timeout and the button matrix pulls lines
+ * low for held buttons. The eeprom section of the firmware is the EEPROM,
+ * accessed through the avr-libc functions or the registers.
+ * EEAR holds the low byte of the address of an EEMEM variable, which is
+ * mapped back to the section by the low byte of the section start.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include "host.h"
+
+// EEPROM programming time of an erase and write
+#define EEPROM_WRITE_US 3400
+// Button bits of main.c and matrix lines connected by each button, the first
+// line driven low pulls the others low through the button
+#define MATRIX_LINES (_BV(PB1) | _BV(PB3) | _BV(PB4))
+static const struct {
+	uint8_t button, line, pulled;
+} matrix[] = {
+	{_BV(0), _BV(PB3), _BV(PB4) | _BV(PB1)}, // Left
+	{_BV(1), _BV(PB1), _BV(PB4)},            // Right
+	{_BV(2), _BV(PB4), _BV(PB1)},            // Down
+	{_BV(3), _BV(PB4), _BV(PB3)},            // Up
+	{_BV(4), _BV(PB3), _BV(PB4)},            // A
+	{_BV(5), _BV(PB1), _BV(PB3) | _BV(PB4)}  // B
+};
+
+extern uint8_t __start_eeprom[] __attribute__((weak));
+extern uint8_t __stop_eeprom[] __attribute__((weak));
+
+volatile uint8_t hostIo[0x40];
+uint64_t hostCycles;
+uint32_t hostInterrupts;
+static uint64_t eepromReady;
+static bool eepromWriting;
+
+// Unused vectors jump to the reset vector on the MCU
+#define BAD_VECTOR(n) \
+	void __vector_##n(void) __attribute__((weak)); \
+	void __vector_##n(void) { \
+		fprintf(stderr, "Interrupt vector %d has no handler\n", n); \
+		exit(2); \
+	}
+BAD_VECTOR(3)
+BAD_VECTOR(5)
+BAD_VECTOR(6)
+BAD_VECTOR(9)
+BAD_VECTOR(10)
+BAD_VECTOR(11)
+BAD_VECTOR(12)
+
+static uint8_t *eepromCell(const void *p);
+
+// Start a write strobed through EECR, the strobe is ignored without EEMPE, and
+// clear EEPE when the write is done
+static void eepromRegisters(void) {
+	uint8_t *cell;
+	
+	if (!(EECR & _BV(EEPE)))
+		return;
+	if (eepromWriting) {
+		if (hostCycles >= eepromReady) {
+			eepromWriting = false;
+			EECR &= ~_BV(EEPE);
+		}
+	} else if (EECR & _BV(EEMPE)) {
+		cell = eepromCell(__start_eeprom + (uint8_t)(EEAR - (uintptr_t)__start_eeprom));
+		*cell = hostIo[0x1D];
+		eepromReady = hostCycles + HOST_US(EEPROM_WRITE_US);
+		eepromWriting = true;
+		EECR &= ~_BV(EEMPE);
+	} else
+		EECR &= ~_BV(EEPE);
+}
+
+// Run pending interrupts in the order of their vectors while enabled
+static void interrupts(void) {
+	uint8_t pending;
+	void (*vector)(void);
+	
+	while (SREG & _BV(SREG_I)) {
+		eepromRegisters();
+		pending = TIFR & TIMSK;
+		if (pending & _BV(OCF1A)) {
+			TIFR &= ~_BV(OCF1A);
+			vector = __vector_3;
+		} else if (pending & _BV(TOV0)) {
+			TIFR &= ~_BV(TOV0);
+			vector = __vector_5;
+		} else if ((EECR & (_BV(EERIE) | _BV(EEPE))) == _BV(EERIE))
+			vector = __vector_6;
+		else if (pending & _BV(OCF1B)) {
+			TIFR &= ~_BV(OCF1B);
+			vector = __vector_9;
+		} else if (pending & _BV(OCF0A)) {
+			TIFR &= ~_BV(OCF0A);
+			vector = __vector_10;
+		} else if (pending & _BV(OCF0B)) {
+			TIFR &= ~_BV(OCF0B);
+			vector = __vector_11;
+		} else
+			break;
+		SREG &= ~_BV(SREG_I);
+		vector();
+		SREG |= _BV(SREG_I);
+		hostInterrupts++;
+	}
+}
+
+// Cycles of a timer 0 step, 0 when the timer is stopped
+static uint16_t timer0Prescaler(void) {
+	static const uint16_t prescaler[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+	
+	return prescaler[TCCR0B & 0x07];
+}
+
+// Cycles of a timer 1 step, 0 when the timer is stopped
+static uint16_t timer1Prescaler(void) {
+	uint8_t cs = TCCR1 & 0x0F;
+	
+	return (cs) ? 1 << (cs - 1) : 0;
+}
+
+// Count one step of timer 1, clearing after OCR1C in CTC mode
+static void timer1Step(void) {
+	uint8_t count = TCNT1;
+	
+	if (count == OCR1A)
+		TIFR |= _BV(OCF1A);
+	if (count == OCR1B)
+		TIFR |= _BV(OCF1B);
+	if ((TCCR1 & _BV(CTC1)) && count == OCR1C)
+		count = 0;
+	else if (++count == 0)
+		TIFR |= _BV(TOV1);
+	TCNT1 = count;
+}
+
+// Cycle of the next step of a timer, after end when it is stopped
+static uint64_t nextStep(uint16_t prescaler, uint64_t end) {
+	return (prescaler) ? (hostCycles / prescaler + 1) * prescaler : end + 1;
+}
+
+// Count one step, clearing on compare match in CTC mode
+static void timer0Step(void) {
+	uint8_t count = TCNT0;
+	
+	if ((TCCR0A & _BV(WGM01)) && count == OCR0A)
+		count = 0;
+	else if (++count == 0)
+		TIFR |= _BV(TOV0);
+	TCNT0 = count;
+	if (count == OCR0A)
+		TIFR |= _BV(OCF0A);
+	if (count == OCR0B)
+		TIFR |= _BV(OCF0B);
+}
+
+void host_delay_cycles(uint64_t cycles) {
+	uint64_t end = hostCycles + cycles, next0, next1;
+	
+	for (;;) {
+		next0 = nextStep(timer0Prescaler(), end);
+		next1 = nextStep(timer1Prescaler(), end);
+		hostCycles = (next0 < next1) ? next0 : next1;
+		if (hostCycles > end)
+			break;
+		if (hostCycles == next0)
+			timer0Step();
+		if (hostCycles == next1)
+			timer1Step();
+		interrupts();
+	}
+	hostCycles = end;
+	eepromRegisters();
+}
+
+void host_delay_us(double us) {
+	host_delay_cycles(HOST_US(us));
+}
+
+void host_sei(void) {
+	SREG |= _BV(SREG_I);
+	interrupts();
+}
+
+// Sleep until an interrupt wakes the MCU. Timers stop in power down
+void host_sleep(void) {
+	uint32_t n = hostInterrupts;
+	uint8_t wdp;
+	
+	if (!(MCUCR & _BV(SE)))
+		return;
+	host_idle();
+	if (MCUCR & _BV(SM1)) {
+		if (!(WDTCR & _BV(WDIE)) || !(SREG & _BV(SREG_I))) {
+			fprintf(stderr, "Power down without a watchdog interrupt\n");
+			exit(2);
+		}
+		// Watchdog timeout of 2K cycles of 128 kHz and up
+		wdp = (WDTCR & 0x07) | ((WDTCR & _BV(WDP3)) ? 0x08 : 0);
+		hostCycles += (2048ULL << wdp) * HOST_F_CPU / 128000;
+		__vector_12();
+		hostInterrupts++;
+		return;
+	}
+	if (((!timer0Prescaler() || !(TIMSK & (_BV(OCIE0A) | _BV(OCIE0B) | _BV(TOIE0)))) &&
+		(!timer1Prescaler() || !(TIMSK & (_BV(OCIE1A) | _BV(OCIE1B)))) && !(EECR & _BV(EERIE))) ||
+		!(SREG & _BV(SREG_I))) {
+		fprintf(stderr, "Idle sleep without an interrupt to wake up\n");
+		exit(2);
+	}
+	while (hostInterrupts == n) {
+		if (timer0Prescaler() || timer1Prescaler())
+			host_delay_cycles((timer0Prescaler()) ? timer0Prescaler() : timer1Prescaler());
+		else {
+			// Only the EEPROM can wake up
+			host_delay_cycles((eepromReady > hostCycles) ? eepromReady - hostCycles : 0);
+			interrupts();
+		}
+	}
+}
+
+// Lines are high by their pull-up unless driven low or pulled low through a
+// held button by a line driven low
+volatile uint8_t *host_pinb(void) {
+	uint8_t i, buttons = host_buttons(), low;
+	
+	low = DDRB & ~PORTB;
+	for (i = 0; i < sizeof(matrix) / sizeof(matrix[0]); i++) {
+		if ((buttons & matrix[i].button) && (low & matrix[i].line))
+			low |= matrix[i].pulled;
+	}
+	hostIo[0x16] = (PORTB | ~DDRB) & ~low;
+	return &hostIo[0x16];
+}
+
+// A read strobe loads the byte at EEAR, other accesses use the register
+volatile uint8_t *host_eedr(void) {
+	if (EECR & _BV(EERE)) {
+		EECR &= ~_BV(EERE);
+		if (eepromWriting) {
+			fprintf(stderr, "EEPROM read during a write\n");
+			exit(2);
+		}
+		hostIo[0x1D] = *eepromCell(__start_eeprom + (uint8_t)(EEAR - (uintptr_t)__start_eeprom));
+	}
+	return &hostIo[0x1D];
+}
+
+// EEPROM accesses wait for the last write to finish
+static uint8_t *eepromCell(const void *p) {
+	if ((const uint8_t *)p < __start_eeprom || (const uint8_t *)p >= __stop_eeprom) {
+		fprintf(stderr, "EEPROM access outside EEMEM variables\n");
+		exit(2);
+	}
+	if (hostCycles < eepromReady)
+		host_delay_cycles(eepromReady - hostCycles);
+	return (uint8_t *)p;
+}
+
+bool host_eeprom_ready(void) {
+	return hostCycles >= eepromReady;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *p) {
+	return *eepromCell(p);
+}
+
+uint16_t eeprom_read_word(const uint16_t *p) {
+	return eeprom_read_byte((const uint8_t *)p) | eeprom_read_byte((const uint8_t *)p + 1) << 8;
+}
+
+uint32_t eeprom_read_dword(const uint32_t *p) {
+	return eeprom_read_word((const uint16_t *)p) | (uint32_t)eeprom_read_word((const uint16_t *)p + 1) << 16;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+	while (n--)
+		*(uint8_t *)dst++ = eeprom_read_byte(src++);
+}
+
+void eeprom_write_byte(uint8_t *p, uint8_t value) {
+	*eepromCell(p) = value;
+	eepromReady = hostCycles + HOST_US(EEPROM_WRITE_US);
+}
+
+void eeprom_write_word(uint16_t *p, uint16_t value) {
+	eeprom_write_byte((uint8_t *)p, value);
+	eeprom_write_byte((uint8_t *)p + 1, value >> 8);
+}
+
+void eeprom_write_dword(uint32_t *p, uint32_t value) {
+	eeprom_write_word((uint16_t *)p, value);
+	eeprom_write_word((uint16_t *)p + 1, value >> 16);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t n) {
+	while (n--)
+		eeprom_write_byte(dst++, *(const uint8_t *)src++);
+}
+
+void eeprom_update_byte(uint8_t *p, uint8_t value) {
+	if (eeprom_read_byte(p) != value)
+		eeprom_write_byte(p, value);
+}
+
+void eeprom_update_word(uint16_t *p, uint16_t value) {
+	eeprom_update_byte((uint8_t *)p, value);
+	eeprom_update_byte((uint8_t *)p + 1, value >> 8);
+}
+
+void eeprom_update_dword(uint32_t *p, uint32_t value) {
+	eeprom_update_word((uint16_t *)p, value);
+	eeprom_update_word((uint16_t *)p + 1, value >> 16);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+	while (n--)
+		eeprom_update_byte(dst++, *(const uint8_t *)src++);
+}
+
+// Integer conversions of avr-libc
+char *ultoa(unsigned long value, char *s, int radix) {
+	char *p = s, *q, c;
+	
+	do {
+		c = value % radix;
+		*p++ = (c < 10) ? '0' + c : 'a' + c - 10;
+		value /= radix;
+	} while (value);
+	*p = '\0';
+	for (q = s, p--; q < p; q++, p--) {
+		c = *q;
+		*q = *p;
+		*p = c;
+	}
+	return s;
+}
+
+char *ltoa(long value, char *s, int radix) {
+	if (value < 0 && radix == 10) {
+		*s = '-';
+		ultoa(-(unsigned long)value, s + 1, radix);
+		return s;
+	}
+	return ultoa(value, s, radix);
+}
+
+char *utoa(unsigned int value, char *s, int radix) {
+	return ultoa(value, s, radix);
+}
+
+char *itoa(int value, char *s, int radix) {
+	return (radix == 10) ? ltoa(value, s, radix) : ultoa((unsigned int)value, s, radix);
+}
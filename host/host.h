@@ -0,0 +1,40 @@
+/*
+ * Host model of the ATtiny45 running the firmware on Linux
+ *
+ * The unmodified firmware is compiled against the stand-in headers of this
+ * directory, with main() renamed to game_main(). Time is counted in CPU
+ * cycles and only passes in I2C transfers, delays, EEPROM writes and sleep,
+ * the cycles of the game logic itself are not counted. Interrupts of the
+ * timers, the EEPROM and the watchdog are run as their flags become set.
+ */
+
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HOST_F_CPU 16000000UL
+#define HOST_US(us) ((uint64_t)((us) * (HOST_F_CPU / 1000000.0) + 0.5))
+
+// Simulated time in CPU cycles and number of interrupts run
+extern uint64_t hostCycles;
+extern uint32_t hostInterrupts;
+
+extern void host_delay_cycles(uint64_t cycles);
+extern void host_delay_us(double us);
+extern void host_sei(void);
+extern void host_sleep(void);
+extern volatile uint8_t *host_pinb(void);
+extern volatile uint8_t *host_eedr(void);
+extern bool host_eeprom_ready(void);
+
+// Provided by the tool: buttons held at the current time, in the bits of the
+// button defines of main.c, and a callback before the MCU goes to sleep
+extern uint8_t host_buttons(void);
+extern void host_idle(void);
+
+// Firmware entry point
+extern int game_main(void);
+
+#endif /* HOST_H_ */
@@ -0,0 +1,251 @@
+/*
+ * Profiles the I2C bus load of the firmware by call site
+ *
+ * The firmware is compiled with -finstrument-functions, so every function
+ * entry and exit updates a shadow stack. Each element on the bus is charged
+ * to the innermost game function and the outermost driver function above it
+ * on that stack, e.g. drawScreen / ssd1306_set_column_address. Bytes held
+ * back by SSD1306_COMBINE are charged where they are flushed. Frames are the
+ * calls of drawScreen(). The random input of -s is played for -t seconds of
+ * simulated time, or the replay of -r until it ends or -t, on the fast bus of
+ * oledemu with -f.
+ *
+ * Usage: i2cprof [-t seconds] [-s seed] [-r file] [-f]
+ */
+
+#include <elf.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host.h"
+#include "input.h"
+#include "ssd1306_emu.h"
+
+#define STACK_DEPTH 64
+#define MAX_SITES   128
+
+typedef struct {
+	uintptr_t addr;
+	const char *name;
+} symbol_t;
+
+typedef struct {
+	const symbol_t *game, *driver;
+	uint32_t transactions, framing, commands, data;
+	uint64_t cycles;
+} site_t;
+
+static jmp_buf done;
+static uint64_t endCycles, busCycles;
+static uint32_t frames, seed = 1;
+static symbol_t *symbols;
+static size_t symbolCount;
+static const symbol_t *drawScreen;
+static const symbol_t *stack[STACK_DEPTH];
+static uint8_t depth;
+static site_t sites[MAX_SITES];
+static uint8_t siteCount;
+
+int main(int argc, char **argv);
+void __cyg_profile_func_enter(void *fn, void *site) __attribute__((no_instrument_function));
+void __cyg_profile_func_exit(void *fn, void *site) __attribute__((no_instrument_function));
+
+static int symbolCompare(const void *a, const void *b) {
+	const symbol_t *x = a, *y = b;
+
+	return (x->addr > y->addr) - (x->addr < y->addr);
+}
+
+// Reads the function symbols of the running executable, relocated by the
+// load address of main()
+static void loadSymbols(void) {
+	FILE *f = fopen("/proc/self/exe", "rb");
+	long size;
+	char *image;
+	Elf64_Ehdr *header;
+	Elf64_Shdr *sections;
+	uintptr_t base = 0;
+	size_t i, j;
+
+	if (!f || fseek(f, 0, SEEK_END) || (size = ftell(f)) <= 0) {
+		perror("/proc/self/exe");
+		exit(2);
+	}
+	image = malloc(size);
+	rewind(f);
+	if (!image || fread(image, 1, size, f) != (size_t)size) {
+		perror("/proc/self/exe");
+		exit(2);
+	}
+	fclose(f);
+	header = (Elf64_Ehdr *)image;
+	sections = (Elf64_Shdr *)(image + header->e_shoff);
+	for (i = 0; i < header->e_shnum; i++) {
+		Elf64_Sym *sym = (Elf64_Sym *)(image + sections[i].sh_offset);
+		const char *names = image + sections[sections[i].sh_link].sh_offset;
+		size_t count = sections[i].sh_size / sizeof(Elf64_Sym);
+
+		if (sections[i].sh_type != SHT_SYMTAB)
+			continue;
+		symbols = realloc(symbols, (symbolCount + count) * sizeof(symbol_t));
+		for (j = 0; j < count; j++) {
+			if (ELF64_ST_TYPE(sym[j].st_info) != STT_FUNC || !sym[j].st_value)
+				continue;
+			symbols[symbolCount].addr = sym[j].st_value;
+			symbols[symbolCount++].name = names + sym[j].st_name;
+			if (!strcmp(names + sym[j].st_name, "main"))
+				base = (uintptr_t)main - sym[j].st_value;
+		}
+	}
+	if (!symbolCount) {
+		fprintf(stderr, "No symbol table, do not strip i2cprof\n");
+		exit(2);
+	}
+	for (i = 0; i < symbolCount; i++)
+		symbols[i].addr += base;
+	qsort(symbols, symbolCount, sizeof(symbol_t), symbolCompare);
+}
+
+static const symbol_t *findSymbol(uintptr_t addr) {
+	symbol_t key = {addr, NULL};
+
+	return bsearch(&key, symbols, symbolCount, sizeof(symbol_t), symbolCompare);
+}
+
+static bool isDriver(const symbol_t *s) {
+	return s && !strncmp(s->name, "ssd1306_", 8);
+}
+
+void __cyg_profile_func_enter(void *fn, void *site) {
+	const symbol_t *s = findSymbol((uintptr_t)fn);
+
+	(void)site;
+	if (s == drawScreen)
+		frames++;
+	if (depth < STACK_DEPTH)
+		stack[depth] = s;
+	depth++;
+}
+
+void __cyg_profile_func_exit(void *fn, void *site) {
+	(void)fn;
+	(void)site;
+	if (depth)
+		depth--;
+}
+
+// Site of the innermost game function and the driver function it called
+static site_t *currentSite(void) {
+	const symbol_t *game = NULL, *driver = NULL;
+	uint8_t i = (depth < STACK_DEPTH) ? depth : STACK_DEPTH;
+
+	while (i--) {
+		if (!isDriver(stack[i])) {
+			game = stack[i];
+			break;
+		}
+		driver = stack[i];
+	}
+	for (i = 0; i < siteCount; i++) {
+		if (sites[i].game == game && sites[i].driver == driver)
+			return &sites[i];
+	}
+	if (siteCount == MAX_SITES)
+		return &sites[MAX_SITES - 1];
+	sites[siteCount].game = game;
+	sites[siteCount].driver = driver;
+	return &sites[siteCount++];
+}
+
+static void trace(uint8_t kind, uint32_t cycles) {
+	site_t *site = currentSite();
+
+	site->cycles += cycles;
+	busCycles += cycles;
+	switch (kind) {
+		case OLED_START: site->transactions++; break;
+		case OLED_ADDRESS:
+		case OLED_CONTROL: site->framing++; break;
+		case OLED_COMMAND: site->commands++; break;
+		case OLED_DATA: site->data++; break;
+	}
+}
+
+void host_idle(void) {
+	if (hostCycles >= endCycles || input_ended())
+		longjmp(done, 1);
+}
+
+static int siteCompare(const void *a, const void *b) {
+	const site_t *x = a, *y = b;
+
+	return (x->cycles < y->cycles) - (x->cycles > y->cycles);
+}
+
+static void report(void) {
+	double n = (frames) ? frames : 1;
+	uint32_t transactions = 0, framing = 0, commands = 0, data = 0;
+	uint8_t i;
+
+	qsort(sites, siteCount, sizeof(site_t), siteCompare);
+	printf("%u frames in %.3f s, bus busy %.1f %% of the time\n", frames,
+		hostCycles / (double)HOST_F_CPU, 100.0 * busCycles / (hostCycles ? hostCycles : 1));
+	printf("\nPer frame: transactions, framing, command and data bytes, bus time\n");
+	printf("%-16s %-36s %8s %8s %8s %8s %9s %6s\n", "Game", "Driver", "trans", "framing",
+		"command", "data", "us", "bus %");
+	for (i = 0; i < siteCount; i++) {
+		site_t *s = &sites[i];
+
+		printf("%-16s %-36s %8.1f %8.1f %8.1f %8.1f %9.1f %6.1f\n",
+			(s->game) ? s->game->name : "-", (s->driver) ? s->driver->name : "-",
+			s->transactions / n, s->framing / n, s->commands / n, s->data / n,
+			s->cycles * 1e6 / HOST_F_CPU / n, 100.0 * s->cycles / (busCycles ? busCycles : 1));
+		transactions += s->transactions;
+		framing += s->framing;
+		commands += s->commands;
+		data += s->data;
+	}
+	printf("%-16s %-36s %8.1f %8.1f %8.1f %8.1f %9.1f %6.1f\n", "Total", "", transactions / n,
+		framing / n, commands / n, data / n, busCycles * 1e6 / HOST_F_CPU / n, 100.0);
+}
+
+int main(int argc, char **argv) {
+	int opt;
+	double seconds = 0;
+	const char *replayFile = NULL;
+	size_t i;
+
+	while ((opt = getopt(argc, argv, "t:s:r:f")) != -1) {
+		switch (opt) {
+			case 't': seconds = strtod(optarg, NULL); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			case 'r': replayFile = optarg; break;
+			case 'f': oled.fastBus = true; break;
+			default:
+				fprintf(stderr, "Usage: %s [-t seconds] [-s seed] [-r file] [-f]\n", argv[0]);
+				return 2;
+		}
+	}
+	loadSymbols();
+	for (i = 0; i < symbolCount; i++) {
+		if (!strcmp(symbols[i].name, "drawScreen"))
+			drawScreen = &symbols[i];
+	}
+	// A replay runs to its end unless limited by -t
+	if (!seconds && !replayFile)
+		seconds = 60;
+	endCycles = (seconds) ? HOST_US(seconds * 1e6) : UINT64_MAX;
+	input_random(seed);
+	if (replayFile && !input_load(replayFile)) {
+		fprintf(stderr, "Cannot load replay %s\n", replayFile);
+		return 2;
+	}
+	oled_reset();
+	oledTrace = trace;
+	if (!setjmp(done))
+		game_main();
+	report();
+	return (oled.errors) ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Button input of the host tools
+ *
+ * Random buttons are pressed and released every 25 ms. The seed of the input
+ * also seeds the random pieces of the firmware. The firmware calls
+ * host_game_step() in place of game_step(), which records the word of buttons
+ * held and pushed of each game tick, so the input can be saved for replay. A
+ * replay seeds the pieces from the file and hands its words to game_step()
+ * instead, so the game does not depend on when the firmware scans the buttons
+ * or how long it renders. The matrix is then left released during a game,
+ * after a game over A is pushed every 200 ms to enter the name and wake up for
+ * the next game. The replay ends after its last word.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "host.h"
+#include "input.h"
+#include "nvm.h"
+#include "tetris.h"
+
+#define MAGIC "TRPL"
+// Bytes of a run, the input word and the tick count
+#define RUN 3
+// Ticks of 25 ms between pushes of A after a game over in a replay
+#define MENU_PUSH 8
+
+
+static uint32_t seed = 1;
+static uint16_t pieceSeed = 1;
+static uint64_t buttonTick;
+static uint32_t ticks;
+static uint8_t buttons, remaining;
+static uint16_t input;
+// Runs of input words and tick count, recorded or loaded
+static uint8_t *runs;
+static size_t runsLength, runsSize, position;
+static bool replay, ended, gameOver;
+
+static uint32_t inputRandom(void) {
+	seed = seed * 1103515245 + 12345;
+	return (seed >> 16) & 0x7FFF;
+}
+
+// Release all buttons, push a single one or keep them
+static uint8_t randomButtons(void) {
+	if (inputRandom() % 4 == 0)
+		return 0;
+	if (inputRandom() % 3 == 0)
+		return 1 << (inputRandom() % 6);
+	return buttons;
+}
+
+static uint16_t replayInput(void) {
+	while (!remaining) {
+		if (position == runsLength) {
+			ended = true;
+			return 0;
+		}
+		input = runs[position] | runs[position + 1] << 8;
+		remaining = runs[position + 2];
+		position += RUN;
+	}
+	remaining--;
+	return input;
+}
+
+static void record(uint16_t w) {
+	if (runsLength && input == w && runs[runsLength - 1] < 255) {
+		runs[runsLength - 1]++;
+		return;
+	}
+	input = w;
+	if (runsLength + RUN > runsSize) {
+		runsSize = (runsSize) ? runsSize * 2 : 4096;
+		runs = realloc(runs, runsSize);
+		if (!runs) {
+			perror("input");
+			exit(2);
+		}
+	}
+	runs[runsLength++] = w;
+	runs[runsLength++] = w >> 8;
+	runs[runsLength++] = 1;
+}
+
+void input_random(uint32_t s) {
+	seed = s;
+	// The LFSR must not be seeded with zero. The first record of the ring is
+	// the newest one of the EEPROM at reset
+	nvRing[0].seed = pieceSeed = (s & 0xFFFF) ? s : 1;
+}
+
+bool input_load(const char *path) {
+	FILE *f = fopen(path, "rb");
+	uint8_t header[6];
+	long size;
+
+	if (!f)
+		return false;
+	if (fread(header, 1, sizeof(header), f) != sizeof(header) || memcmp(header, MAGIC, 4)
+		|| fseek(f, 0, SEEK_END) || (size = ftell(f) - sizeof(header)) < 0 || size % RUN
+		|| fseek(f, sizeof(header), SEEK_SET) || !(runs = malloc(size + 1))
+		|| fread(runs, 1, size, f) != (size_t)size) {
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+	runsLength = runsSize = size;
+	nvRing[0].seed = pieceSeed = header[4] | header[5] << 8;
+	replay = true;
+	return true;
+}
+
+bool input_save(const char *path) {
+	FILE *f = fopen(path, "wb");
+	uint8_t header[6] = {MAGIC[0], MAGIC[1], MAGIC[2], MAGIC[3], pieceSeed, pieceSeed >> 8};
+	bool ok;
+
+	if (!f)
+		return false;
+	ok = fwrite(header, 1, sizeof(header), f) == sizeof(header)
+		&& fwrite(runs, 1, runsLength, f) == runsLength;
+	return !fclose(f) && ok;
+}
+
+// Set once a replay runs out of input
+bool input_ended(void) {
+	return ended;
+}
+
+// Game ticks run
+uint32_t input_ticks(void) {
+	return ticks;
+}
+
+uint8_t host_game_step(uint16_t w) {
+	uint8_t result;
+
+	ticks++;
+	if (replay)
+		w = replayInput();
+	else
+		record(w);
+	result = game_step(w);
+	gameOver = result & GAME_OVER;
+	return result;
+}
+
+uint8_t host_buttons(void) {
+	while (buttonTick < hostCycles / INPUT_TICK) {
+		buttonTick++;
+		if (replay)
+			buttons = (gameOver && buttonTick % MENU_PUSH == 0) ? BUTTON_A : 0;
+		else
+			buttons = randomButtons();
+	}
+	return buttons;
+}
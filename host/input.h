@@ -0,0 +1,28 @@
+/*
+ * Button input of the host tools
+ *
+ * Input is either generated at random or replayed from a file. A replay file
+ * holds the 4 byte magic "TRPL", the 16-bit seed of the random pieces, least
+ * significant byte first, and then runs of game ticks of 3 bytes each, the
+ * input word of game_step() least significant byte first and the number of
+ * ticks from 1 to 255.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Period of the random buttons in cycles
+#define INPUT_TICK (HOST_F_CPU / 40)
+
+extern void input_random(uint32_t seed);
+extern bool input_load(const char *path);
+extern bool input_save(const char *path);
+extern bool input_ended(void);
+extern uint32_t input_ticks(void);
+// Called by the firmware in place of game_step(), see the Makefile
+extern uint8_t host_game_step(uint16_t input);
+
+#endif /* INPUT_H_ */
@@ -0,0 +1,99 @@
+/*
+ * Runs the firmware on the SSD1306 model and dumps or checks its frames
+ *
+ * The random input is seeded by -s and saved for replay with -w, or input is
+ * replayed from a file with -r until it ends, see input.c. A frame is taken
+ * before each sleep when the controller received a transaction and the
+ * visible image changed. Frames are written as frame00000.pbm and onwards to
+ * the dump directory or compared against the golden frames of that name, in
+ * portrait orientation with -p.
+ * The game logic waits for slow renders, so the frames of builds with a
+ * different bus load only match with the fast bus of -f, where every build
+ * renders each game tick.
+ *
+ * Usage: oledemu [-n frames] [-s seed] [-r file] [-w file] [-f] [-p] [-d dir] [-g dir]
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host.h"
+#include "input.h"
+#include "ssd1306_emu.h"
+
+static jmp_buf done;
+static uint32_t frames, maxFrames = 1000, mismatches, seed = 1;
+static uint8_t last[OLED_IMAGE];
+static const char *dumpDir, *goldenDir, *replayFile, *recordFile;
+static bool portrait;
+
+void host_idle(void) {
+	uint8_t image[OLED_IMAGE], golden[OLED_IMAGE];
+	char path[512];
+	
+	if (input_ended())
+		longjmp(done, 1);
+	if (!oled.written)
+		return;
+	oled.written = false;
+	oled_image(image);
+	if (frames && !memcmp(image, last, sizeof(last)))
+		return;
+	memcpy(last, image, sizeof(last));
+	if (dumpDir) {
+		snprintf(path, sizeof(path), "%s/frame%05u.pbm", dumpDir, frames);
+		if (!oled_write_pbm(path, image, portrait)) {
+			perror(path);
+			exit(2);
+		}
+	}
+	if (goldenDir) {
+		snprintf(path, sizeof(path), "%s/frame%05u.pbm", goldenDir, frames);
+		if (!oled_read_pbm(path, golden, portrait) || memcmp(image, golden, sizeof(golden))) {
+			if (!mismatches)
+				printf("First mismatch: %s at %.3f s\n", path, hostCycles / (double)HOST_F_CPU);
+			mismatches++;
+		}
+	}
+	if (++frames == maxFrames)
+		longjmp(done, 1);
+}
+
+int main(int argc, char **argv) {
+	int opt;
+	
+	while ((opt = getopt(argc, argv, "n:s:r:w:fpd:g:")) != -1) {
+		switch (opt) {
+			case 'n': maxFrames = strtoul(optarg, NULL, 0); break;
+			case 's': seed = strtoul(optarg, NULL, 0); break;
+			case 'r': replayFile = optarg; break;
+			case 'w': recordFile = optarg; break;
+			case 'f': oled.fastBus = true; break;
+			case 'p': portrait = true; break;
+			case 'd': dumpDir = optarg; break;
+			case 'g': goldenDir = optarg; break;
+			default:
+				fprintf(stderr, "Usage: %s [-n frames] [-s seed] [-r file] [-w file] [-f] [-p] [-d dir] [-g dir]\n", argv[0]);
+				return 2;
+		}
+	}
+	input_random(seed);
+	if (replayFile && !input_load(replayFile)) {
+		fprintf(stderr, "Cannot load replay %s\n", replayFile);
+		return 2;
+	}
+	oled_reset();
+	if (!setjmp(done))
+		game_main();
+	if (recordFile && !input_save(recordFile)) {
+		perror(recordFile);
+		return 2;
+	}
+	printf("%u frames in %.3f s, %u transactions, %u bytes, %u protocol errors\n", frames,
+		hostCycles / (double)HOST_F_CPU, oled.transactions, oled.bytes, oled.errors);
+	if (goldenDir)
+		printf("%u of %u frames differ from %s\n", mismatches, frames, goldenDir);
+	return (oled.errors || mismatches) ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+/*
+ * Replays recorded input through the firmware without a display
+ *
+ * The game runs from reset on the SSD1306 model until the replay ends. The
+ * outcome is a CRC-32 of the frames, taken as in oledemu, and of the EEPROM
+ * holding the high score and seed, so a change to the game logic or the
+ * renderer can be checked against the outcome of the build before it. The
+ * replay feeds each game tick its recorded input, so slow renders do not
+ * change the game, the fast bus only keeps it from dropping frames. The bus
+ * of the build is modelled with -b. The host time of the run times the
+ * change on the same workload. Replays are recorded with oledemu -w.
+ *
+ * Usage: replay [-b] file
+ */
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "host.h"
+#include "input.h"
+#include "ssd1306_emu.h"
+
+extern uint8_t __start_eeprom[] __attribute__((weak));
+extern uint8_t __stop_eeprom[] __attribute__((weak));
+
+static jmp_buf done;
+static uint32_t frames, frameCrc = 0xFFFFFFFF;
+static uint8_t last[OLED_IMAGE];
+
+static uint32_t crc32(uint32_t crc, const uint8_t *p, size_t n) {
+	uint8_t i;
+
+	while (n--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return crc;
+}
+
+void host_idle(void) {
+	uint8_t image[OLED_IMAGE];
+
+	if (input_ended())
+		longjmp(done, 1);
+	if (!oled.written)
+		return;
+	oled.written = false;
+	oled_image(image);
+	if (frames && !memcmp(image, last, sizeof(last)))
+		return;
+	memcpy(last, image, sizeof(last));
+	frameCrc = crc32(frameCrc, image, sizeof(image));
+	frames++;
+}
+
+int main(int argc, char **argv) {
+	struct timespec start, end;
+	double seconds;
+	int opt;
+
+	oled.fastBus = true;
+	while ((opt = getopt(argc, argv, "b")) != -1) {
+		switch (opt) {
+			case 'b': oled.fastBus = false; break;
+			default:
+				fprintf(stderr, "Usage: %s [-b] file\n", argv[0]);
+				return 2;
+		}
+	}
+	if (optind != argc - 1) {
+		fprintf(stderr, "Usage: %s [-b] file\n", argv[0]);
+		return 2;
+	}
+	if (!input_load(argv[optind])) {
+		fprintf(stderr, "Cannot load replay %s\n", argv[optind]);
+		return 2;
+	}
+	oled_reset();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if (!setjmp(done))
+		game_main();
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%u ticks, %u frames in %.3f s, %u protocol errors\n", input_ticks(), frames,
+		hostCycles / (double)HOST_F_CPU, oled.errors);
+	printf("Frames %08X, EEPROM %08X\n", ~frameCrc,
+		~crc32(0xFFFFFFFF, __start_eeprom, __stop_eeprom - __start_eeprom));
+	printf("Host time %.3f s, %.0f ticks/s\n", seconds, input_ticks() / seconds);
+	return (oled.errors) ? 1 : 0;
+}
@@ -0,0 +1,319 @@
+/*
+ * Host model of the SSD1306 controller on the I2C bus
+ *
+ * Control bytes select commands or data for the next byte (continuation bit
+ * set) or for the rest of the transaction. Commands with parameters may span
+ * control bytes, as in the datasheet. Page, horizontal and vertical
+ * addressing advance the address pointer of the 1K GDDRAM. Scrolling, fading
+ * and blinking are recorded but not animated. Each transaction takes the bus
+ * time of the I2C routine selected in ssd1306_i2c.h.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "ssd1306_i2c.h"
+#include "ssd1306.h"
+#include "ssd1306_emu.h"
+#include "host.h"
+
+// Estimated cycles of a byte and of the start and stop conditions, including
+// the instructions around the delays
+#if defined(I2C_USI)
+#define BYTE_CYCLES  HOST_US(9 * (I2C_USI_LOW + I2C_USI_HIGH) + 3)
+#define START_CYCLES HOST_US(I2C_USI_LOW + I2C_START_STOP_DELAY + 2)
+#define STOP_CYCLES  HOST_US(I2C_START_STOP_DELAY + I2C_IDLE_TIME)
+#elif defined(I2C_FAST)
+#define BYTE_CYCLES  (9 * I2C_BIT_CYCLES + 8)
+#define START_CYCLES (I2C_HIGH_CYCLES + I2C_LOW_CYCLES + 12)
+#define STOP_CYCLES  (I2C_HIGH_CYCLES + I2C_LOW_CYCLES + 22)
+#else
+#define BYTE_CYCLES  (9 * (HOST_US(I2C_FALL_TIME + 2 * I2C_HALF_CLOCK) + 14) + 8)
+#define START_CYCLES HOST_US(I2C_START_STOP_DELAY + I2C_HALF_CLOCK)
+#define STOP_CYCLES  HOST_US(I2C_FALL_TIME + I2C_START_STOP_DELAY + I2C_IDLE_TIME)
+#endif
+#define FAST_BYTE_CYCLES HOST_US(1)
+// Errors reported in full, the rest is only counted
+#define ERROR_REPORTS 10
+
+oled_t oled;
+void (*oledTrace)(uint8_t kind, uint32_t cycles);
+// Transaction state: address byte expected, control byte expected, data or
+// commands of the continuation bit and command bytes collected
+static enum {BUS_IDLE, BUS_ADDRESS, BUS_CONTROL, BUS_STREAM} bus = BUS_IDLE;
+static bool dataStream, single;
+static uint8_t command[8], commandLength;
+
+static void error(const char *s, uint8_t b) {
+	oled.errors++;
+	if (oled.errors <= ERROR_REPORTS)
+		fprintf(stderr, "SSD1306 at %.3f ms: %s 0x%02X\n", hostCycles / (HOST_F_CPU / 1000.0), s, b);
+}
+
+// Power on reset state
+void oled_reset(void) {
+	bool fastBus = oled.fastBus;
+	
+	memset(&oled, 0, sizeof(oled));
+	oled.fastBus = fastBus;
+	oled.mode = 2;
+	oled.columnEnd = OLED_WIDTH - 1;
+	oled.pageEnd = 7;
+	oled.mux = 63;
+	oled.contrast = 0x7F;
+	bus = BUS_IDLE;
+	commandLength = 0;
+}
+
+// Number of bytes of a command including its parameters
+static uint8_t commandSize(uint8_t c) {
+	switch (c) {
+		case 0x26: case 0x27:
+			return 7;
+		case 0x29: case 0x2A:
+			return 6;
+		case 0x21: case 0x22: case 0xA3:
+			return 3;
+		case 0x20: case 0x23: case 0x81: case 0x8D: case 0xA8: case 0xD3:
+		case 0xD5: case 0xD6: case 0xD9: case 0xDA: case 0xDB:
+			return 2;
+	}
+	return 1;
+}
+
+static void runCommand(void) {
+	uint8_t c = command[0];
+	
+	oled.commands++;
+	if (c <= 0x0F) {
+		oled.pageColumn = (oled.pageColumn & 0xF0) | c;
+		oled.column = oled.pageColumn;
+	} else if (c <= 0x1F) {
+		oled.pageColumn = (oled.pageColumn & 0x0F) | (c & 0x07) << 4;
+		oled.column = oled.pageColumn;
+	} else if (c == 0x20) {
+		oled.mode = command[1] & 0x03;
+		if (oled.mode == 3)
+			error("Invalid addressing mode", command[1]);
+	} else if (c == 0x21) {
+		oled.column = oled.columnStart = command[1] & 0x7F;
+		oled.columnEnd = command[2] & 0x7F;
+	} else if (c == 0x22) {
+		oled.page = oled.pageStart = command[1] & 0x07;
+		oled.pageEnd = command[2] & 0x07;
+	} else if (c == 0x23) {
+		oled.fade = command[1] & 0x3F;
+	} else if (c == 0x2E || c == 0x2F) {
+		oled.scroll = c & 1;
+	} else if (c >= 0x40 && c <= 0x7F) {
+		oled.startLine = c & 0x3F;
+	} else if (c == 0x81) {
+		oled.contrast = command[1];
+	} else if (c == 0xA0 || c == 0xA1) {
+		oled.segmentRemap = c & 1;
+	} else if (c == 0xA4 || c == 0xA5) {
+		oled.entireOn = c & 1;
+	} else if (c == 0xA6 || c == 0xA7) {
+		oled.inverse = c & 1;
+	} else if (c == 0xA8) {
+		oled.mux = command[1] & 0x3F;
+		if (oled.mux < 15)
+			error("Invalid multiplex ratio", command[1]);
+	} else if (c == 0xAE || c == 0xAF) {
+		oled.on = c & 1;
+	} else if (c >= 0xB0 && c <= 0xB7) {
+		oled.page = c & 0x07;
+	} else if (c == 0xC0 || c == 0xC8) {
+		oled.comRemap = (c & 0x08) != 0;
+	} else if (c == 0xD3) {
+		oled.offset = command[1] & 0x3F;
+	} else if (c == 0xDA) {
+		if (command[1] & 0x30)
+			error("Unsupported COM pins configuration", command[1]);
+	} else if (c == 0x24 || c == 0x25 || (c >= 0x30 && c <= 0x3F) || (c >= 0x90 && c <= 0x9F) ||
+		(c >= 0xA9 && c <= 0xAD) || (c >= 0xB8 && c <= 0xBF) || c >= 0xE4) {
+		error("Unknown command", c);
+	}
+}
+
+// Write a byte at the address pointer and advance it in the addressing mode
+static void writeData(uint8_t b) {
+	oled.data++;
+	oled.ram[oled.page][oled.column] = b;
+	if (oled.mode == 2) {
+		if (oled.column == OLED_WIDTH - 1)
+			oled.column = oled.pageColumn;
+		else
+			oled.column++;
+	} else if (oled.mode == 0) {
+		if (oled.column != oled.columnEnd)
+			oled.column++;
+		else {
+			oled.column = oled.columnStart;
+			oled.page = (oled.page == oled.pageEnd) ? oled.pageStart : (oled.page + 1) & 0x07;
+		}
+	} else {
+		if (oled.page != oled.pageEnd)
+			oled.page = (oled.page + 1) & 0x07;
+		else {
+			oled.page = oled.pageStart;
+			oled.column = (oled.column == oled.columnEnd) ? oled.columnStart : (oled.column + 1) & 0x7F;
+		}
+	}
+}
+
+// Parenthesized names are not replaced by the SSD1306_COMBINE macros
+void (i2c_start)(uint8_t addr) {
+	uint32_t cycles = (oled.fastBus) ? 0 : START_CYCLES;
+	host_delay_cycles(cycles);
+	if (oledTrace)
+		oledTrace(OLED_START, cycles);
+	if (bus != BUS_IDLE)
+		error("Repeated start", addr);
+	if (commandLength)
+		error("Command cut off by start", command[0]);
+	commandLength = 0;
+	bus = BUS_ADDRESS;
+	(i2c_write)(addr);
+}
+
+void (i2c_write)(uint8_t data) {
+	uint32_t cycles = (oled.fastBus) ? FAST_BYTE_CYCLES : BYTE_CYCLES;
+	host_delay_cycles(cycles);
+	if (oledTrace) {
+		if (bus == BUS_STREAM)
+			oledTrace((dataStream) ? OLED_DATA : OLED_COMMAND, cycles);
+		else
+			oledTrace((bus == BUS_CONTROL) ? OLED_CONTROL : OLED_ADDRESS, cycles);
+	}
+	oled.bytes++;
+	oled.written = true;
+	switch (bus) {
+		case BUS_IDLE:
+			error("Byte outside transaction", data);
+			break;
+		case BUS_ADDRESS:
+			oled.transactions++;
+			if (data != SSD1306_ADDR + I2C_WRITE)
+				error("Wrong slave address", data);
+			bus = BUS_CONTROL;
+			break;
+		case BUS_CONTROL:
+			if (data & 0x3F)
+				error("Invalid control byte", data);
+			dataStream = (data & SSD1306_DATA) != 0;
+			single = (data & SSD1306_CONTINUE) != 0;
+			bus = BUS_STREAM;
+			break;
+		case BUS_STREAM:
+			if (dataStream) {
+				if (commandLength)
+					error("Data before end of command", command[0]);
+				writeData(data);
+			} else {
+				command[commandLength++] = data;
+				if (commandLength == commandSize(command[0])) {
+					runCommand();
+					commandLength = 0;
+				}
+			}
+			if (single)
+				bus = BUS_CONTROL;
+			break;
+	}
+}
+
+void (i2c_stop)(void) {
+	uint32_t cycles = (oled.fastBus) ? 0 : STOP_CYCLES;
+	host_delay_cycles(cycles);
+	if (oledTrace)
+		oledTrace(OLED_STOP, cycles);
+	if (bus == BUS_IDLE)
+		error("Stop outside transaction", 0);
+	if (commandLength)
+		error("Command cut off by stop", command[0]);
+	commandLength = 0;
+	bus = BUS_IDLE;
+}
+
+// Packed image of the rows shown by the COM outputs. Remapped segments and
+// COM scan direction mirror the image as seen on the panel
+void oled_image(uint8_t *image) {
+	uint8_t x, y, row, column, pixel;
+	
+	memset(image, 0, OLED_IMAGE);
+	if (!oled.on)
+		return;
+	for (y = 0; y < OLED_HEIGHT && y <= oled.mux; y++) {
+		row = (oled.comRemap) ? oled.mux - y : y;
+		row = (row + oled.startLine + oled.offset) & 0x3F;
+		for (x = 0; x < OLED_WIDTH; x++) {
+			column = (oled.segmentRemap) ? OLED_WIDTH - 1 - x : x;
+			pixel = (oled.ram[row >> 3][column] >> (row & 7)) & 1;
+			if (oled.entireOn)
+				pixel = 1;
+			else if (oled.inverse)
+				pixel ^= 1;
+			if (pixel)
+				image[y * OLED_STRIDE + x / 8] |= 0x80 >> (x & 7);
+		}
+	}
+}
+
+// Pixel of the image, turned a quarter counter clock wise in portrait
+// orientation as the game is played
+static uint8_t *pixelByte(uint8_t *image, uint8_t x, uint8_t y, bool portrait, uint8_t *mask) {
+	if (portrait) {
+		uint8_t t = y;
+		y = OLED_HEIGHT - 1 - x;
+		x = t;
+	}
+	*mask = 0x80 >> (x & 7);
+	return &image[y * OLED_STRIDE + x / 8];
+}
+
+// Binary portable bitmap, set bits are lit pixels
+bool oled_write_pbm(const char *path, const uint8_t *image, bool portrait) {
+	uint8_t out[OLED_IMAGE], mask, *p;
+	uint8_t x, y, w = (portrait) ? OLED_HEIGHT : OLED_WIDTH, h = (portrait) ? OLED_WIDTH : OLED_HEIGHT;
+	FILE *f;
+	
+	memset(out, 0, sizeof(out));
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			p = pixelByte((uint8_t *)image, x, y, portrait, &mask);
+			if (*p & mask)
+				out[y * (w / 8) + x / 8] |= 0x80 >> (x & 7);
+		}
+	}
+	if (!(f = fopen(path, "wb")))
+		return false;
+	fprintf(f, "P4\n%u %u\n", w, h);
+	fwrite(out, 1, sizeof(out), f);
+	return fclose(f) == 0;
+}
+
+bool oled_read_pbm(const char *path, uint8_t *image, bool portrait) {
+	uint8_t in[OLED_IMAGE], mask, *p;
+	unsigned x, y, w, h;
+	FILE *f;
+	bool ok;
+	
+	if (!(f = fopen(path, "rb")))
+		return false;
+	ok = fscanf(f, "P4 %u %u", &w, &h) == 2 && fgetc(f) != EOF &&
+		w == ((portrait) ? OLED_HEIGHT : OLED_WIDTH) && h == ((portrait) ? OLED_WIDTH : OLED_HEIGHT) &&
+		fread(in, 1, sizeof(in), f) == sizeof(in);
+	fclose(f);
+	if (!ok)
+		return false;
+	memset(image, 0, OLED_IMAGE);
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++) {
+			if (in[y * (w / 8) + x / 8] & 0x80 >> (x & 7)) {
+				p = pixelByte(image, x, y, portrait, &mask);
+				*p |= mask;
+			}
+		}
+	}
+	return true;
+}
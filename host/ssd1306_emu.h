@@ -0,0 +1,48 @@
+/*
+ * Host model of the SSD1306 controller on the I2C bus
+ *
+ * Takes the place of ssd1306_i2c.c and decodes the bytes of i2c_start(),
+ * i2c_write() and i2c_stop() the way the controller does. The visible image
+ * is computed from the 1K GDDRAM and the display settings.
+ */
+
+#ifndef SSD1306_EMU_H_
+#define SSD1306_EMU_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define OLED_WIDTH  128
+#define OLED_HEIGHT 32
+// Bytes of a packed image row, most significant bit is the leftmost pixel
+#define OLED_STRIDE (OLED_WIDTH / 8)
+#define OLED_IMAGE  (OLED_STRIDE * OLED_HEIGHT)
+
+typedef struct {
+	uint8_t ram[8][OLED_WIDTH];
+	// Address pointer and addressing settings
+	uint8_t mode, column, page, columnStart, columnEnd, pageStart, pageEnd, pageColumn;
+	// Display settings
+	uint8_t startLine, offset, mux, contrast, fade;
+	bool on, inverse, entireOn, segmentRemap, comRemap, scroll;
+	// Bus counters and protocol errors
+	uint32_t transactions, bytes, commands, data, errors;
+	// Set by any transaction, cleared by the tool
+	bool written;
+	// Every byte takes 1 us and start and stop take no time
+	bool fastBus;
+} oled_t;
+
+// Elements of a transaction passed to the trace hook
+enum {OLED_START, OLED_ADDRESS, OLED_CONTROL, OLED_COMMAND, OLED_DATA, OLED_STOP};
+
+extern oled_t oled;
+// Called with the kind and the bus cycles of each element when set
+extern void (*oledTrace)(uint8_t kind, uint32_t cycles);
+
+extern void oled_reset(void);
+extern void oled_image(uint8_t *image);
+extern bool oled_write_pbm(const char *path, const uint8_t *image, bool portrait);
+extern bool oled_read_pbm(const char *path, uint8_t *image, bool portrait);
+
+#endif /* SSD1306_EMU_H_ */
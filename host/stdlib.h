@@ -0,0 +1,15 @@
+/*
+ * Host stand-in for the integer conversions avr-libc adds to stdlib.h
+ */
+
+#ifndef HOST_STDLIB_H_
+#define HOST_STDLIB_H_
+
+#include_next <stdlib.h>
+
+extern char *itoa(int value, char *s, int radix);
+extern char *utoa(unsigned int value, char *s, int radix);
+extern char *ltoa(long value, char *s, int radix);
+extern char *ultoa(unsigned long value, char *s, int radix);
+
+#endif /* HOST_STDLIB_H_ */
@@ -0,0 +1,30 @@
+/*
+ * Host stand-in for the atomic blocks of avr-libc
+ */
+
+#ifndef HOST_UTIL_ATOMIC_H_
+#define HOST_UTIL_ATOMIC_H_
+
+#include <avr/interrupt.h>
+
+static __inline__ uint8_t __iCliRetVal(void) {
+	cli();
+	return 1;
+}
+
+static __inline__ void __iSeiParam(const uint8_t *__s) {
+	(void)__s;
+	sei();
+}
+
+static __inline__ void __iRestore(const uint8_t *__s) {
+	SREG = *__s;
+	if (*__s & _BV(SREG_I))
+		sei();
+}
+
+#define ATOMIC_BLOCK(type) for (type, __ToDo = __iCliRetVal(); __ToDo; __ToDo = 0)
+#define ATOMIC_RESTORESTATE uint8_t sreg_save __attribute__((__cleanup__(__iRestore))) = SREG
+#define ATOMIC_FORCEON uint8_t sreg_save __attribute__((__cleanup__(__iSeiParam))) = 0
+
+#endif /* HOST_UTIL_ATOMIC_H_ */
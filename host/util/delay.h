@@ -0,0 +1,13 @@
+/*
+ * Host stand-in for the busy wait delays of avr-libc
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+extern void host_delay_us(double us);
+
+#define _delay_us(us) host_delay_us(us)
+#define _delay_ms(ms) host_delay_us((ms) * 1000.0)
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -7,20 +7,42 @@
  * The internal 16 MHz PLL is used as the system clock source. A 2x3 button
  * matrix with reduced IO pins is used for user input. Portrait screen
  * orientation is used, for efficient use of the screen area.
+ * Timer 1 is the timebase, counting in steps of 16 us. Its only interrupt is
+ * the compare match every 4 ms, which adds up the time and scans one line of
+ * the button matrix, queueing the buttons down when they change.
  * The SSD1306 controller, capable of driving an 128x64 OLED screen, has 1K
  * SRAM. When driving an 128x32 OLED, only 512 bytes are used. The ATtiny45 has
  * just 256 bytes of SRAM, which is not enough to hold a frame buffer. The
  * screen is rendered in rows of 32 bits and each row is sent in four pages
  * of one byte to the display controller using the I2C bus at up to 45 frames
- * per second. Pushing the up and down button simultaneously displays the FPS
- * rate, if compiled with the DEBUG_FPS flag. The remaining 512 bytes of the
- * SSD1306 controller is used for double buffering, if compiled with the
- * DOUBLE_BUFFER flag.
+ * per second. The display controller is put in vertical addressing mode, so
+ * the whole play field is streamed in a single I2C transfer. Pushing the up
+ * and down button simultaneously displays the FPS rate, if compiled with the
+ * DEBUG_FPS flag. With the DEBUG_PROFILE flag the same buttons then cycle
+ * through the running average and the maximum of the time taken by the input,
+ * game logic, play field, header and frame switch phases of a frame, timed in
+ * 16 us steps of timer 1. The remaining 512 bytes of the SSD1306
+ * controller is used for double buffering, if compiled with the DOUBLE_BUFFER
+ * flag.
+ * Only the play field rows and pages that changed since a frame was last
+ * written are sent, if compiled with the DIRTY_RENDER flag.
  * The game uses a 10x30 playing field and implements hard and soft
  * dropping of the pieces, as well as delayed auto shift (DAS), entry delay
- * (ARE), piece preview, hold piece and the Super Rotation System.
+ * (ARE), piece preview, hold piece and the Super Rotation System. Its wall
+ * kicks are tried if compiled with the SRS_KICKS flag and the score is kept
+ * as packed BCD if compiled with the BCD_SCORE flag.
+ * The A button rotates counter clockwise instead of holding the piece, if
+ * compiled with the ROTATE_CCW flag. The game logic in tetris.c only sees the
+ * buttons held and pushed in each tick, so it runs unchanged on a PC.
  * The high score and player name are stored in EEPROM. The system will enter
  * sleep mode automatically and the game will wake up again by a button push.
+ * With the NVM_QUEUE flag EEPROM writes are queued and programmed by the
+ * EEPROM ready interrupt and the random seed and number of games are kept in
+ * a wear leveling ring, see nvm.c.
+ * The MCU is put in idle sleep mode for the rest of each frame.
+ * Line clears flash the screen, the game over screen blinks and the screen
+ * dims before sleep, all done by the effects of the display controller, if
+ * compiled with the OLED_EFFECTS flag.
  * In game power draw is <20 mA and standby power draw is <1 mA.
  */ 
 
@@ -39,52 +61,116 @@
 #include <string.h>
 #include "ssd1306_i2c.h"
 #include "ssd1306.h"
+#include "tetris.h"
+#include "nvm.h"
 
 #define DOUBLE_BUFFER // Uses 36 bytes of progmem
 #define DEBUG_FPS     // Uses 86 bytes of progmem
+//#define DEBUG_PROFILE // Time each phase of a frame, needs DEBUG_FPS and uses 23 bytes of SRAM
+//#define DIRTY_RENDER  // Only resend changed rows and pages of the play field
+//#define OLED_EFFECTS  // Flash line clears, blink game over and dim before sleep
+
+#if defined(DEBUG_PROFILE) && defined(NVM_QUEUE)
+#error "DEBUG_PROFILE and NVM_QUEUE together leave no SRAM for the stack"
+#endif
 
-// Buffers for font drawing
+// Buffer for font drawing
 char buffer[6];
-uint32_t bitmap[8];
-// Button state variables
-static bool buttonLeft, buttonRight, buttonDown, buttonUp, buttonA, buttonB;
-// Play field is 10 bits wide and 30 rows tall
-#define WELL_MAX 30
-uint16_t well[WELL_MAX];
-// Piece variables
-#define NO_PIECE 255
-int8_t pieceX, pieceY;
-uint8_t piece, rotate, nextPiece, holdPiece = NO_PIECE;
-// Collision detect mode enum
-typedef enum {CD_DROP, CD_ROTATE, CD_LEFT, CD_RIGHT, CD_LOCK} mode_t;
-// Random number seed variable
-uint16_t random_number;
-// Delay in frames
-#define DROP_DELAY  20
-#define LOCK_DELAY  20
-#define ENTRY_DELAY 20
-#define SHIFT_DELAY 10
-#define SOFT_DELAY  2
-// Millisecond counter
-volatile uint16_t timer0_millis;
+// Ring buffer of the buttons down after each change, filled by the timer
+// interrupt and consumed by the main loop. The button bits are in tetris.h
+#define EVENT_MAX 8
+volatile uint8_t events[EVENT_MAX];
+volatile uint8_t eventHead, eventTail;
+// Button state of the last scan and buttons of the scan in progress
+volatile uint8_t buttonState;
+uint8_t buttonScan, scanColumn;
+// Lines of the button matrix on port B, driven low for each column
+#define MATRIX_LINES (_BV(1) | _BV(3) | _BV(4))
+#define NO_COLUMN    3
+const uint8_t PROGMEM columnLines[] = {_BV(1), _BV(3), _BV(4)};
+#ifdef DIRTY_RENDER
+// Changed rows (bit 30 for hold and next boxes) and pages for each ssd1306 frame
+#define DIRTY_BOXES WELL_MAX
+#define DIRTY_ALL   0x7FFFFFFFUL
+uint32_t dirtyRows[2];
+uint8_t dirtyPages[2];
+// Piece state of the last rendered frame
+int8_t drawnX, drawnY;
+uint8_t drawnPiece;
+// Next piece and hold piece, which is NO_PIECE when empty
+uint16_t drawnBoxes;
+#endif
+// Game logic runs at a fixed rate of 40 ticks per second, at most 4 ticks
+// are run without rendering when rendering is too slow. Tick time in ms
+#define TICK_TIME   25
+#define MAX_TICKS   4
+#ifdef OLED_EFFECTS
+// Ticks of the line clear flash
+#define FLASH_DELAY 4
+// Time the game over screen blinks before it fades out in milliseconds
+#define GAME_OVER_TIME 3000
+#endif
+// Cursor blink time of the name entry in milliseconds
+#define BLINK_TIME  400
+// Timer 1 counts 16 us steps and clears every 4 ms
+#define TIMER1_TOP    249
+#define TIMER1_PERIOD 4000
+// Time at the last clear of timer 1
+volatile uint16_t timer1_millis;
 #ifdef DEBUG_FPS
-bool showFps = false;
+// Value shown in the header, the score, the fps or a readout of a phase
+#define READOUT_SCORE 0
+#define READOUT_FPS   1
+#ifdef DEBUG_PROFILE
+#define READOUTS      (2 + PHASES * PHASE_READOUTS)
+#else
+#define READOUTS      2
 #endif
-// Non volatile storage
-uint16_t EEMEM nvHighScore = 0;
+uint8_t readout;
+#endif
+#ifdef DEBUG_PROFILE
+// Phases of a frame. The input and game logic phases are timed in each tick
+#define PHASE_INPUT  0
+#define PHASE_LOGIC  1
+#define PHASE_DRAW   2
+#define PHASE_HUD    3
+#define PHASE_SWITCH 4
+#define PHASES       5
+// Readouts of each phase are the running average and the maximum in
+// microseconds
+#define PHASE_READOUTS 2
+typedef struct {
+	uint16_t avg, max;
+} phase_t;
+phase_t phases[PHASES];
+// Time of the last mark
+uint16_t phaseMark;
+// Rest of the frame is not counted, set by the game over and the readout change
+bool phaseSkip;
+const char PROGMEM phaseNames[] = "INGADRHUSW";
+const char PROGMEM readoutNames[] = "AVHI";
+#endif
+// Level and score or fps last drawn in each controller frame
+uint8_t drawnLevel[2];
+score_t drawnValue[2];
+// Non volatile storage
+score_t EEMEM nvHighScore = 0;
 uint8_t EEMEM nvName[6] = "";
-uint16_t EEMEM nvRandomSeed = 1;
-// Block mask for play field
-const uint8_t PROGMEM mask[] = {0xDB, 0xB6, 0x6D, 0xDB};
-// Each piece is 4x4 bits and has 4 rotations
-const uint16_t PROGMEM pieces[] = {
-	0xF00, 0x4444, 0xF0, 0x2222, // I
-	0x170, 0x622, 0x74, 0x223,   // J
-	0x470, 0x226, 0x71, 0x322,   // L
-	0x660, 0x660, 0x660, 0x660,  // O
-	0x630, 0x264, 0x63, 0x132,   // S
-	0x270, 0x262, 0x72, 0x232,   // T
-	0x360, 0x462, 0x36, 0x231    // Z
+// Pixels of 3 blocks for each page, with side lines of well. Page 0 shows
+// blocks 0-2, page 1 blocks 2-4, page 2 blocks 5-7 and page 3 blocks 7-9.
+// The second half has the block mask applied for the middle column
+const uint8_t PROGMEM blockPixels[2][4][8] = {
+	{
+		{0x01, 0x0F, 0x71, 0x7F, 0x81, 0x8F, 0xF1, 0xFF},
+		{0x00, 0x03, 0x1C, 0x1F, 0xE0, 0xE3, 0xFC, 0xFF},
+		{0x00, 0x07, 0x38, 0x3F, 0xC0, 0xC7, 0xF8, 0xFF},
+		{0x80, 0x81, 0x8E, 0x8F, 0xF0, 0xF1, 0xFE, 0xFF}
+	}, {
+		{0x01, 0x0B, 0x51, 0x5B, 0x81, 0x8B, 0xD1, 0xDB},
+		{0x00, 0x02, 0x14, 0x16, 0xA0, 0xA2, 0xB4, 0xB6},
+		{0x00, 0x05, 0x28, 0x2D, 0x40, 0x45, 0x68, 0x6D},
+		{0x80, 0x81, 0x8A, 0x8B, 0xD0, 0xD1, 0xDA, 0xDB}
+	}
 };
 // 90 degree clock wise rotated 6x8 pixel font of digits and caps only
 const uint8_t PROGMEM font6x8_90[] = {
@@ -128,127 +214,279 @@ const uint8_t PROGMEM font6x8_90[] = {
 const char PROGMEM pstrScore[] = "SCORE";
 
 // Prototypes
-static uint8_t clearLine(void);
-static bool collisionDetect(mode_t mode);
+static uint8_t boxLine(uint8_t p, uint8_t i);
 static void drawHeader(void);
-static void drawPiece(uint8_t x, uint8_t y, uint8_t p, uint32_t *row);
 static void drawScreen(void);
 static void drawString_p(uint8_t x, uint8_t y, const char *s);
-static void drawValue(uint8_t x, uint8_t y, uint16_t v);
-static uint16_t lfsr16_next(uint16_t n);
+static void drawValue(uint8_t x, uint8_t y, score_t v);
+static void drawValues(uint8_t level, score_t value);
+static void driveColumn(uint8_t col);
+#ifdef DIRTY_RENDER
+static void markDirty(uint32_t rows, uint8_t pages);
+static void markPiece(int8_t x, int8_t y);
+static void markRows(uint8_t x, bool cleared);
+#endif
+static uint8_t getPushed(uint8_t *held);
 static void matrix_init(void);
 static uint16_t millis(void);
-static void newPiece(void);
-static uint16_t prng(void);
-static void prng_init(void);
-static void scanMatrix(void);
-static void scoreScreen (uint16_t score);
+#ifdef DEBUG_PROFILE
+static uint16_t micros(void);
+static void profileMark(uint8_t phase);
+static score_t profileValue(void);
+#endif
+static uint8_t readColumn(uint8_t col);
+static uint8_t scanMatrix(void);
+static void scoreScreen (void);
 static void setupScreen(void);
 static void sleepMode(void);
-static void swapPiece(void);
-static void timer0_init();
+static void timer1_init(void);
 static void waitRelease(void);
 
-// Draw line x of the specified piece p at position y in row
-void drawPiece(uint8_t x, uint8_t y, uint8_t p, uint32_t *row) {
-	uint8_t i, xx, yy;
+#ifdef DIRTY_RENDER
+// Mark rows and pages as changed in both frames
+void markDirty(uint32_t rows, uint8_t pages) {
+	dirtyRows[0] |= rows;
+	dirtyPages[0] |= pages;
+#ifdef DOUBLE_BUFFER
+	dirtyRows[1] |= rows;
+	dirtyPages[1] |= pages;
+#endif
+}
+
+// Mark rows and pages covered by a piece at position x, y
+void markPiece(int8_t x, int8_t y) {
+	int8_t first, last;
 	
-	xx = x * 4; // x is between 0 and 3
-	yy = (y * 3) + 1; // y is between 0 and 30
-	// Scan 4 bits (one line), each bit represents a block
-	for (i = xx; i < xx + 4; i++) {
-		if (pgm_read_word(&pieces[p]) & 1 << i) {
-			*row |= 7UL << yy; // 3 pixels for each block
-		}
-		yy += 3;
+	first = (y * 3 + 1) / 8; // y is between -2 and 9
+	last = (y * 3 + 12) / 8;
+	if (first < 0)
+		first = 0;
+	if (last > 3)
+		last = 3;
+	markDirty(((x < 0) ? 0xFUL >> -x : 0xFUL << x) & ~(~0UL << WELL_MAX), (2 << last) - (1 << first));
+}
+
+// Mark rows of the well changed by the game logic from row x. Locking only
+// adds blocks to the 4 rows of the piece, so the pages of the blocks now in
+// these rows cover the change. Cleared lines move all rows above them, which
+// may change any page
+void markRows(uint8_t x, bool cleared) {
+	uint8_t i, pages = 0xF;
+	uint16_t line = 0;
+	
+	if (cleared) {
+		markDirty(~0UL << x & WELL_ROWS, pages);
+		return;
 	}
+	for (i = x; i < x + 4 && i < WELL_MAX; i++)
+		line |= game.well[i];
+	// Each page shows 3 blocks, see drawScreen()
+	pages = ((line & 0x007) ? 1 : 0) | ((line & 0x01C) ? 2 : 0) | ((line & 0x0E0) ? 4 : 0) | ((line & 0x380) ? 8 : 0);
+	markDirty(0xFUL << x & WELL_ROWS, pages);
+}
+#endif
+
+// Line i of the first rotation of piece p in a box, empty without a piece
+uint8_t boxLine(uint8_t p, uint8_t i) {
+	return (p == NO_PIECE) ? 0 : pgm_read_word(&pieces[p * 4]) >> i * 4 & 0xF;
 }
 
-// Render screen for each ssd1306 page
+// Render screen in vertical addressing mode, streaming all pages of each column
 void drawScreen(void) {
-	uint8_t x, y, p, i;
-	uint32_t row;
+	uint8_t x, y, i, n, first = 0, last = 3, frame, pixels;
+	uint8_t bits[4];
+	uint16_t line;
+	bool open = false;
+#ifdef DIRTY_RENDER
+	uint8_t f = ssd1306_current_render_frame();
 	
-	for (y = 0; y < 4; y++) {
-		ssd1306_set_cursor(0, y);
-		ssd1306_send_data_start();
-		i2c_write(0xFF); // Bottom line of well
-		for (x = 0; x < WELL_MAX + 5; x++) {
+	// Mark old and new location of the piece and changed boxes since last render
+	if (game.pieceX != drawnX || game.pieceY != drawnY || game.piece * 4 + game.rotate != drawnPiece) {
+		markPiece(drawnX, drawnY);
+		markPiece(game.pieceX, game.pieceY);
+		drawnX = game.pieceX;
+		drawnY = game.pieceY;
+		drawnPiece = game.piece * 4 + game.rotate;
+	}
+	if ((game.nextPiece | game.holdPiece << 3) != drawnBoxes) {
+		markDirty(1UL << DIRTY_BOXES, 0xF);
+		drawnBoxes = game.nextPiece | game.holdPiece << 3;
+	}
+	if (!dirtyPages[f])
+		return;
+	// Span of changed pages
+	while (!(dirtyPages[f] & 1 << first))
+		first++;
+	while (!(dirtyPages[f] & 1 << last))
+		last--;
+#endif
+	frame = ssd1306_current_render_frame() * SSD1306_PAGES;
+	for (x = 0; x < WELL_MAX + 5; x++) {
+#ifdef DIRTY_RENDER
+		// Send runs of changed rows only
+		if (!(dirtyRows[f] & 1UL << ((x < WELL_MAX) ? x : DIRTY_BOXES))) {
+			if (open)
+				i2c_stop();
+			open = false;
+			continue;
+		}
+#endif
+		if (!open) {
+			// Vertical addressing mode, pages and columns of the run
+			ssd1306_send_command_start();
+			i2c_write(0x20);
+			i2c_write(1);
+			i2c_write(0x22);
+			i2c_write(frame + first);
+			i2c_write(frame + last);
+			i2c_write(0x21);
+			i2c_write((x == 0) ? 0 : (x <= WELL_MAX) ? x * 3 + 1 : x * 3 - 1);
+			i2c_write(127);
+			i2c_stop();
+			ssd1306_send_data_start();
+			if (x == 0) {
+				for (y = first; y <= last; y++)
+					i2c_write(0xFF); // Bottom line of well
+			}
+			open = true;
+		}
+		if (x == WELL_MAX || x == WELL_MAX + 4) {
+			// Draw top and bottom lines of rectangles for hold and next pieces,
+			// a single column of all blocks
+			line = 0x3FF;
+			n = 1;
+		} else {
 			if (x < WELL_MAX) {
-				row = 1 << 0 | 1UL << 31; // Side lines of well
-				// Draw blocks
-				for (i = 0; i < 10; i++) {
-					if (well[x] & 1 << i) {
-						row |= 7UL << ((i * 3) + 1); // 3 pixels for each block
-					}
-				}
-				// Draw line of the current piece in row
-				if (x >= pieceX && x < pieceX + 4) {
-					drawPiece(x - pieceX, pieceY, piece * 4 + rotate, &row);
-				}
-			} else if (x == WELL_MAX || x == WELL_MAX + 4) {
-				// Draw top and bottom lines of rectangles for hold and next pieces
-				i2c_write(0xFF);
-				continue;
+				// Draw blocks and line of the current piece, rows below the piece
+				// wrap to above it
+				line = game.well[x];
+				i = x - game.pieceX;
+				if (i < 4)
+					line |= game.pieceLines[i] >> PIECE_MARGIN;
 			} else {
-				// Draw sides of rectangles for hold and next pieces
-				row = 1 << 0 | 1UL << 15 | 1UL << 31;
-				// Draw next piece
-				drawPiece(x - (WELL_MAX + 1), 6, nextPiece * 4, &row);
-				// Draw hold piece
-				if (holdPiece != NO_PIECE)
-					drawPiece(x - (WELL_MAX + 1), 0, holdPiece * 4, &row);
+				// Draw next piece at the right and hold piece at the left
+				i = x - (WELL_MAX + 1);
+				line = boxLine(game.nextPiece, i) << 6 | boxLine(game.holdPiece, i);
+			}
+			n = 3;
+		}
+		// Select 3 blocks for each page
+		bits[0] = line & 7;
+		bits[1] = (line >> 2) & 7;
+		bits[2] = (line >> 5) & 7;
+		bits[3] = (line >> 7) & 7;
+		// Draw the pages of each column, looking up 3 pixels for each block with
+		// the mask applied to the middle column
+		for (i = 0; i < n; i++) {
+			for (y = first; y <= last; y++) {
+				pixels = pgm_read_byte(&blockPixels[i == 1][y][bits[y]]);
+				// Draw middle line of rectangles for hold and next pieces
+				if (x > WELL_MAX && y == 1)
+					pixels |= 0x80;
+				i2c_write(pixels);
 			}
-			// Select page, draw 3 rows and apply mask to middle row
-			p = ((uint8_t *)&row)[y];
-			i2c_write(p);
-			i2c_write(p & pgm_read_byte(&mask[y]));
-			i2c_write(p);
 		}
-		i2c_stop();
 	}
+	if (open)
+		i2c_stop();
+	// Back to page addressing mode
+	ssd1306_send_command_start();
+	i2c_write(0x20);
+	i2c_write(2);
+	i2c_stop();
+#ifdef DIRTY_RENDER
+	dirtyRows[f] = 0;
+	dirtyPages[f] = 0;
+#endif
 }
 
-// Draws maximal 5 digits or caps of 6x8 pixels at position x starting on page y
+// Draws maximal 5 digits or caps of 6x8 pixels at position x starting on page y.
+// Each page to the bottom of the screen is rasterized into 8 columns and sent,
+// which also erases old chars
 void drawString_p(uint8_t x, uint8_t y, const char *s) {
-	uint8_t i = 0, j, c, shift;
+	uint8_t i, j, c, page, columns[8];
+	int8_t shift;
 	uint16_t offset;
 	
-	memset(bitmap, 0, sizeof(bitmap));
-	shift = y * 8; // A page is 8 pixels
-	while ((c = (s) ? pgm_read_byte(s + i) : buffer[i])) {	
-		// Don't draw space	
-		if (c > 32) {
+	for (page = y; page < 4; page++) {
+		memset(columns, 0, sizeof(columns));
+		// Pixel offset of each char in this page plus 8, a char is 6 pixels wide
+		shift = (y - page) * 8 + 8;
+		for (i = 0; (c = (s) ? pgm_read_byte(s + i) : buffer[i]); i++, shift += 6) {
+			// Don't draw space or chars outside this page
+			if (c <= 32 || shift <= 2 || shift >= 16)
+				continue;
 			// Chars A-Z are immediately after digits in this font
 			if (c > 64)
 				c -= 7;
 			// Digit 0 is the first char and each char is 7 bytes
 			offset = (uint16_t)(c - 48) * 7;
-			for (j = 1; j < 8; j++)
-				bitmap[j] |= (uint32_t)pgm_read_byte(&font6x8_90[offset++]) << shift;
+			for (j = 1; j < 8; j++)
+				columns[j] |= (uint16_t)pgm_read_byte(&font6x8_90[offset++]) << shift >> 8;
 		}
-		shift += 6; // A char is 6 pixels wide
-		i++;
-	}
-	for (i = y; i < 4; i++) {
-		ssd1306_set_cursor(x, i);
+		ssd1306_set_cursor(x, page);
 		ssd1306_send_data_start();
 		for (j = 0; j < 8; j++)
-			i2c_write(((uint8_t *)&bitmap[j])[i]);
+			i2c_write(columns[j]);
 		i2c_stop();
 	}
 }
 
+#ifdef BCD_SCORE
+// Convert packed BCD value to array without leading zeros and draw string
+void drawValue(uint8_t x, uint8_t y, score_t v) {
+	uint8_t i = 0, c, shift = 20;
+	
+	do {
+		shift -= 4;
+		c = (v >> shift) & 0xF;
+		if (c || i || !shift)
+			buffer[i++] = c + '0';
+	} while (shift);
+	buffer[i] = 0;
+	drawString_p(x, y, NULL);
+}
+#else
 // Convert value to array and draw string
-void drawValue(uint8_t x, uint8_t y, uint16_t v) {
+void drawValue(uint8_t x, uint8_t y, score_t v) {
 	utoa(v, buffer, 10);
 	drawString_p(x, y, NULL);
 }
+#endif
 
-// Draw score or FPS string on top the screen
+// Draw level and score or fps only when changed since last drawn in this frame
+void drawValues(uint8_t level, score_t value) {
+	uint8_t f = ssd1306_current_render_frame();
+	
+	if (level != drawnLevel[f]) {
+		drawnLevel[f] = level;
+		drawValue(104, 3, level);
+	}
+	if (value != drawnValue[f]) {
+		drawnValue[f] = value;
+		drawValue(112, 0, value);
+	}
+}
+
+// Draw score, FPS or phase readout string on top the screen
 void drawHeader(void) {
+#ifdef DEBUG_PROFILE
+	uint8_t r = readout - 2;
+	
+	if (readout > READOUT_FPS) {
+		// Name of the phase and of the readout
+		buffer[0] = pgm_read_byte(&phaseNames[r / PHASE_READOUTS * 2]);
+		buffer[1] = pgm_read_byte(&phaseNames[r / PHASE_READOUTS * 2 + 1]);
+		buffer[2] = ' ';
+		buffer[3] = pgm_read_byte(&readoutNames[r % PHASE_READOUTS * 2]);
+		buffer[4] = pgm_read_byte(&readoutNames[r % PHASE_READOUTS * 2 + 1]);
+		buffer[5] = 0;
+		drawString_p(120, 0, NULL);
+		return;
+	}
+#endif
 #ifdef DEBUG_FPS
-	drawString_p(120, 0, (showFps) ? PSTR("FPS  ") : pstrScore);
+	drawString_p(120, 0, (readout == READOUT_FPS) ? PSTR("FPS  ") : pstrScore);
 #else
 	drawString_p(120, 0, pstrScore);
 #endif	
@@ -260,46 +498,67 @@ void setupScreen(void) {
 	ssd1306_on();
 	drawHeader();
 	drawString_p(104, 0, PSTR("LEV"));
-	memset(well, 0, sizeof(well));
+	// Values are not drawn yet
+	memset(drawnLevel, 0xFF, sizeof(drawnLevel));
+	memset(drawnValue, 0xFF, sizeof(drawnValue));
+#ifdef DIRTY_RENDER
+	markDirty(DIRTY_ALL, 0xF);
+#endif
 }
 
 // End of game screen
-void scoreScreen (uint16_t score) {
+void scoreScreen (void) {
 	bool blink = false;
-	uint8_t i = 0, c = 65, delay = 0, cnt = 16;
-	uint16_t highScore;
+	uint8_t i = 0, c = 65, cnt = 16, held = 0, button;
+	uint16_t blinkTime;
+	score_t highScore;
 	
+#ifdef OLED_EFFECTS
+	// Let the controller blink the game over screen
+	ssd1306_blink(1);
+#endif
 	drawString_p(72, 0, PSTR(" GAME"));
 	drawString_p(64, 0, PSTR(" OVER"));
 	drawString_p(56, 0, PSTR("HIGH "));
 	drawString_p(48, 0, pstrScore);
-	// Read high score from EEPROM
-	highScore = eeprom_read_word(&nvHighScore);
-	if (highScore != 0xFFFF && score < highScore) {
+	// Read high score from EEPROM, after the queued writes
+	nvm_flush();
+	eeprom_read_block(&highScore, &nvHighScore, sizeof(highScore));
+	// Packed BCD values compare like binary ones
+	if (highScore != (score_t)~0 && game.score < highScore) {
 		// Score is below high score, read player name from EEPROM
 		eeprom_read_block(&buffer, &nvName, sizeof(buffer));
 		drawString_p(40, 0, NULL);
 		drawValue(32, 0, highScore);
+#ifdef OLED_EFFECTS
+		// Keep blinking until a button is pushed or the time is over, the fade
+		// out of the sleep mode replaces the blinking
+		waitRelease();
+		blinkTime = millis();
+		while (!getPushed(&held) && millis() - blinkTime < GAME_OVER_TIME)
+			sleep_mode();	// Idle until the next interrupt
+#endif
 		return;
 	}
-	// New high score
+#ifdef OLED_EFFECTS
+	// New high score, stop blinking while the name is entered
+	ssd1306_disable_fade_out_and_blinking();
+#endif
 	drawString_p(40, 0, PSTR(" NAME"));
 	memset(buffer, 0, sizeof(buffer));
+	waitRelease();
+	blinkTime = millis() + BLINK_TIME;
 	do {
-		scanMatrix();
+		// Get next pushed button
+		button = getPushed(&held);
 		// Handle left button
-		if (buttonLeft && i > 0) {
-			waitRelease();
+		if (button == BUTTON_LEFT && i > 0)
 			i--;
-		}
 		// Handle right button
-		if (buttonRight && i < 4) {
-			waitRelease();
+		if (button == BUTTON_RIGHT && i < 4)
 			i++;
-		}
 		// Handle up button
-		if (buttonUp) {
-			waitRelease();
+		if (button == BUTTON_UP) {
 			cnt = 16;
 			if (c == 32)
 				c = 65;
@@ -311,8 +570,7 @@ void scoreScreen (uint16_t score) {
 			}
 		}
 		// Handle down button
-		if (buttonDown) {
-			waitRelease();
+		if (button == BUTTON_DOWN) {
 			cnt = 16;
 			if (c == 32)
 				c = 90;
@@ -326,19 +584,22 @@ void scoreScreen (uint16_t score) {
 		buffer[i] = (blink) ? 32 : c;	// Alternate char and space at current index
 		drawString_p(32, 0, NULL);
 		buffer[i] = c;					// Store char
-		// Toggle boolean blink every 256 cycles
-		if (--delay == 0) {
+		// Toggle boolean blink, independent of the bus speed
+		if ((int16_t)(millis() - blinkTime) >= 0) {
+			blinkTime += BLINK_TIME;
 			blink ^= true;
 			// Check for idle timeout
 			if (--cnt == 0)
 				break;
 		}
-	} while (!buttonA && !buttonB);
+		sleep_mode();	// Idle until the next interrupt
+	} while (button != BUTTON_A && button != BUTTON_B);
 	waitRelease();
 	drawString_p(32, 0, NULL);
-	// Store score and player in EEPROM
-	eeprom_write_block(&buffer, &nvName, sizeof(nvName));
-	eeprom_write_word(&nvHighScore, score);
+	// Queue score and player for EEPROM. The queue writes from the buffer and
+	// the game, which are kept until sleepMode() has flushed the queue
+	nvm_write(&nvName, &buffer, sizeof(nvName));
+	nvm_write(&nvHighScore, &game.score, sizeof(game.score));
 }
 
 // Dummy ISR
@@ -346,358 +607,379 @@ EMPTY_INTERRUPT(WDT_vect);
 
 // Periodically scan the button matrix in sleep mode using WDT
 void sleepMode(void) {
-	uint8_t cnt = 80;
+	uint8_t cnt = 80, buttons;
 	
-	eeprom_write_word(&nvRandomSeed, random_number);
+	nvRecord.seed = game.random_number;
+	nvRecord.games++;
+	nvm_save();
+#ifdef OLED_EFFECTS
+	// Let the controller dim the screen until it is turned off
+	ssd1306_fade_out(7);
+#endif
+	// The EEPROM ready interrupt does not wake up from power down
+	nvm_flush();
+	// Stop the timer interrupt and release the matrix line it drives
+	TIMSK = 0x00;
+	driveColumn(NO_COLUMN);
 	cli();
 	WDTCR = _BV(WDCE) | _BV(WDE);				// Watchdog change enable
 	WDTCR = _BV(WDIE) | _BV(WDP1) | _BV(WDP0);	// Watchdog timeout interrupt enable, period 0.125 s
 	sei();
 	do {
-		scanMatrix();
+		buttons = scanMatrix();
+		ssd1306_flush();						// Release the bus
 		MCUCR = _BV(BODSE) | _BV(BODS);			// BOD sleep enable
 		MCUCR = _BV(BODS) | _BV(SM1) | _BV(SE);	// BOD sleep, sleep mode power-down, sleep enable
 		sleep_cpu();							// Put the device into sleep mode
 		MCUCR = 0x00;							// Sleep disable
 		if (--cnt == 0)
 			ssd1306_off();						// Turn display off
-	} while (!buttonLeft && !buttonRight && !buttonUp && !buttonDown && !buttonA && !buttonB);
+	} while (!buttons);
 	MCUSR = 0x00;					// Clear watchdog reset flag
 	WDTCR = _BV(WDCE) | _BV(WDE);	// Watchdog change enable
 	WDTCR = 0x00;					// Disable watchdog
+	// Resume scanning with the wake up buttons already down
+	buttonState = buttons;
+	buttonScan = scanColumn = 0;
+	driveColumn(0);
+	TIMSK = _BV(OCIE1A);
 	waitRelease();
+#ifdef OLED_EFFECTS
+	ssd1306_disable_fade_out_and_blinking();
+#endif
 	setupScreen();
+#ifdef DOUBLE_BUFFER
+	// The other frame still holds the last game
+	ssd1306_switchFrame();
+	setupScreen();
+#endif
 }
 
-// Collision detect and piece locking procedure
-bool collisionDetect(mode_t mode) {
-	uint8_t i;
-	int8_t x, y;
-	
-	for (i = 0; i < 16; i++) {
-		x = pieceX + i / 4;
-		y = pieceY + i % 4;
-		switch (mode) {
-			case CD_DROP: x--; break;	// Check below piece
-			case CD_LEFT: y--; break;	// Check left of piece
-			case CD_RIGHT: y++;			// Check right of piece
-			default: ;					// Check current location
-		}
-		if (pgm_read_word(&pieces[piece * 4 + rotate]) & 1 << i) {
-			if (mode == CD_LOCK)
-				// Store block (one bit) in well array
-				well[x] |= 1 << y;
-			else {
-				// Check for overlapping block
-				if (x < 0 || well[x] & 1 << y)
-					return true;
-				// Check if block is outside playing field at the left
-				if ((mode == CD_ROTATE || mode == CD_LEFT) && y < 0)
-					return true;
-				// Check if block is outside playing field at the right
-				if ((mode == CD_ROTATE || mode == CD_RIGHT) && y > 9)
-					return true;
-			}
-		}
-	}
-	return false;
+// Initialize button matrix
+void matrix_init(void) {
+	driveColumn(0);
 }
 
-// Clear rows of blocks that span entire playing field. Returns number of cleared lines
-uint8_t clearLine(void) {
-	uint8_t x, xx, s = 0;
+// Release the lines of all columns with pull up and drive the line of column
+// col low, when it is a column. Only the matrix bits of the port are changed,
+// the I2C routines use single bit instructions on the same port so they can't
+// be disturbed when called from the interrupt
+void driveColumn(uint8_t col) {
+	uint8_t bit;
 	
-	for (x = 0; x < WELL_MAX; x++) {
-		// Check if all 10 bits are set
-		if (well[x] >= 0x3FF) {
-			// Clear line by shifting blocks down one row
-			for (xx = x; xx < WELL_MAX - 1; xx++) {
-				well[xx] = well[xx + 1];
-			}
-			well[WELL_MAX - 1] = 0;
-			// Count cleared lines
-			s++;
-		}
+	DDRB &= ~MATRIX_LINES;	// Lines as input
+	PORTB |= MATRIX_LINES;	// Lines pull up
+	if (col < 3) {
+		bit = pgm_read_byte(&columnLines[col]);
+		DDRB |= bit;		// Line as output
+		PORTB &= ~bit;		// Line low
 	}
-	return s;
-}
-
-// Galois Linear Feedback Shift Register
-uint16_t lfsr16_next(uint16_t n) {
-	return (n >> 1) ^ (-(n & 0x1) & 0xB400);
-}
-
-// Pseudo Random Number Generator
-uint16_t prng(void) {
-	return (random_number = lfsr16_next(random_number));
 }
 
-// Put next piece on playing field
-void newPiece(void) {
-	pieceX = WELL_MAX - 3;
-	pieceY = 3;
-	piece = nextPiece;
-	rotate = 0;
-	// NES-like randomizer
-	nextPiece = prng() % 8;
-	if (nextPiece == 7 || nextPiece == piece) {
-		nextPiece = prng() % 7;
+// Read buttons of column col while its line is driven low
+uint8_t readColumn(uint8_t col) {
+	uint8_t buttons = 0;
+	
+	if (col == 0) {
+		// PB1 low
+		if (bit_is_clear(PINB, 4))
+			buttons = (bit_is_clear(PINB, 3)) ? BUTTON_B : BUTTON_RIGHT;
+	} else if (col == 1) {
+		// PB3 low
+		if (bit_is_clear(PINB, 4))
+			buttons = (bit_is_clear(PINB, 1)) ? BUTTON_LEFT : BUTTON_A;
+	} else {
+		// PB4 low
+		if (bit_is_clear(PINB, 1))
+			buttons |= BUTTON_DOWN;
+		if (bit_is_clear(PINB, 3))
+			buttons |= BUTTON_UP;
 	}
+	return buttons;
 }
 
-// Swap falling piece with hold piece
-void swapPiece(void) {
-	uint8_t temp;
+// Scan whole button matrix while the timer interrupt is stopped
+uint8_t scanMatrix(void) {
+	uint8_t col, buttons = 0;
 	
-	temp = piece;
-	piece = holdPiece;
-	holdPiece = temp;
-	pieceX = WELL_MAX - 3;
-	pieceY = 3;
-	rotate = 0;
-}
-
-// Initialize button matrix
-void matrix_init(void) {
-	PORTB |= _BV(1) | _BV(3) | _BV(4); // enable pull up
+	for (col = 0; col < 3; col++) {
+		driveColumn(col);
+		_delay_us(75);
+		buttons |= readColumn(col);
+	}
+	driveColumn(NO_COLUMN);
+	return buttons;
 }
 
-// Scan button matrix
-void scanMatrix(void) {
-	buttonA = buttonB = buttonDown = buttonLeft = buttonRight = buttonUp = false;
-	DDRB |= _BV(1);   // PB1 as output
-	PORTB &= ~_BV(1); // PB1 low
-	_delay_us(75);
-	if (bit_is_clear(PINB, 4)) {
-		if (bit_is_clear(PINB, 3))
-			buttonB = true;
-		else
-			buttonRight = true;
-	}	
-	DDRB &= ~_BV(1); // PB1 as input
-	PORTB |= _BV(1); // PB1 pull up
-	DDRB |= _BV(3);  // PB3 as output
-	PORTB &= ~_BV(3);// PB3 low
-	_delay_us(75);
-	if (bit_is_clear(PINB, 4)) {
-		if (bit_is_clear(PINB, 1))
-			buttonLeft = true;
-		else
-			buttonA = true;
+// Update the buttons held from the queue and return the buttons pushed since
+// the last call
+uint8_t getPushed(uint8_t *held) {
+	uint8_t tail, pushed = 0;
+	
+	for (tail = eventTail; tail != eventHead; tail = (tail + 1) & (EVENT_MAX - 1)) {
+		pushed |= events[tail] & ~*held;
+		*held = events[tail];
 	}
-	DDRB &= ~_BV(3); // PB3 as input
-	PORTB |= _BV(3); // PB3 pull up
-	DDRB |= _BV(4);  // PB4 as output
-	PORTB &= ~_BV(4);// PB4 low
-	_delay_us(75);
-	if (bit_is_clear(PINB, 1))
-		buttonDown = true;
-	if (bit_is_clear(PINB, 3))
-		buttonUp = true;
-	DDRB &= ~_BV(4); // PB4 as input
-	PORTB |= _BV(4); // PB4 pull up
+	eventTail = tail;
+	return pushed;
 }
 
-// Waits for all buttons to be released
+// Waits for all buttons to be released and discards their changes
 void waitRelease(void) {
-	do {
-		scanMatrix();
-	} while (buttonLeft || buttonRight || buttonUp || buttonDown || buttonA || buttonB);
+	while (buttonState)
+		sleep_mode();	// Idle until the next interrupt
+	eventTail = eventHead;
 }
 
-// Count milliseconds
-ISR(TIMER0_COMPA_vect) {
-	timer0_millis++;
+// Count the period of timer 1 and scan one column of the button matrix. The
+// line of the column was driven low by the previous interrupt and has settled
+// since
+ISR(TIMER1_COMPA_vect) {
+	uint8_t head;
+	
+	timer1_millis += TIMER1_PERIOD / 1000;
+	buttonScan |= readColumn(scanColumn);
+	if (++scanColumn == 3) {
+		scanColumn = 0;
+		// A whole scan takes 12 ms, longer than the contacts bounce, so each
+		// scan reads the buttons either before or after the bounce. A change is
+		// queued again by the next scan when the buffer is full
+		head = (eventHead + 1) & (EVENT_MAX - 1);
+		if (buttonScan != buttonState && head != eventTail) {
+			events[eventHead] = buttonState = buttonScan;
+			eventHead = head;
+		}
+		buttonScan = 0;
+	}
+	driveColumn(scanColumn);
 }
 
-// Get current millis
+// Wakes up the main loop at the next tick
+EMPTY_INTERRUPT(TIMER1_COMPB_vect);
+
+// Get current millis, the 16 us steps are counted as 1/64 ms. The compare match
+// flag is set as the counter clears, so a pending match adds a period not yet
+// counted. The flag is read before the counter, a low count is checked again
+// for a match between both reads
 uint16_t millis(void) {
 	uint16_t ms;
+	uint8_t count, flag;
 	
 	ATOMIC_BLOCK(ATOMIC_FORCEON) {
-		ms = timer0_millis;
+		ms = timer1_millis;
+		flag = TIFR;
+		count = TCNT1;
+		if (count < TIMER1_TOP / 2)
+			flag |= TIFR;
+		if (flag & _BV(OCF1A))
+			ms += TIMER1_PERIOD / 1000;
 	}
-	return ms;
+	return ms + (count >> 6);
 }
 
-// Initialize 1 millisecond timer
-void timer0_init() {
-	TCCR0A = _BV(WGM01);
-	TCCR0B = _BV(CS00) | _BV(CS01);
-	OCR0A = ((F_CPU / 1000) / 64) - 1;
-	TIMSK = _BV(OCIE0A);
-	sei();
+#ifdef DEBUG_PROFILE
+// Get current micros, wrapping every 65 ms. The millis at the last clear times
+// 1000 wrap the same way, so no separate count is kept. The pending match is
+// handled like in millis()
+uint16_t micros(void) {
+	uint16_t us;
+	uint8_t count, flag;
+	
+	ATOMIC_BLOCK(ATOMIC_FORCEON) {
+		us = timer1_millis * 1000;
+		flag = TIFR;
+		count = TCNT1;
+		if (count < TIMER1_TOP / 2)
+			flag |= TIFR;
+		if (flag & _BV(OCF1A))
+			us += TIMER1_PERIOD;
+	}
+	return us + count * 16;
+}
+
+// Count the time since the last mark in the phase. Each phase is counted
+// as it ends, so no times are kept until the end of the frame
+void profileMark(uint8_t phase) {
+	uint16_t now = micros(), t = now - phaseMark;
+	phase_t *p = &phases[phase];
+	
+	phaseMark = now;
+	if (phaseSkip)
+		return;
+	if (t > p->max)
+		p->max = t;
+	// Running average of about 16 samples
+	p->avg += ((int16_t)(t - p->avg)) / 16;
+}
+
+// Value of the phase readout
+score_t profileValue(void) {
+	uint8_t r = readout - 2;
+	uint16_t v;
+	phase_t *p = &phases[r / PHASE_READOUTS];
+	
+	v = (r % PHASE_READOUTS) ? p->max : p->avg;
+#ifdef BCD_SCORE
+	return (uint32_t)(v / 10000) << 16 | toBcd(v % 10000);
+#else
+	return v;
+#endif
 }
+#endif
 
-// Read random seed from EEPROM
-void prng_init(void) {
-	random_number = eeprom_read_word(&nvRandomSeed);
-	newPiece();
-	newPiece();
+// Initialize timer 1 to count 16 us steps and clear every 4 ms
+void timer1_init(void) {
+	OCR1A = OCR1C = TIMER1_TOP;
+	TCCR1 = _BV(CTC1) | _BV(CS13) | _BV(CS10);	// Clear after OCR1C, prescaler 256
+	TIMSK = _BV(OCIE1A);
+	sei();
 }
 
 // Main loop
 int main(void) {
-	bool dropPiece = false, mayHold = true, holdButtonUp = false, holdButtonB = false;
-	uint8_t holdButtonLeft = 0, holdButtonRight = 0, level = 0, lines = 0, temp;
-	uint8_t dropDelay = DROP_DELAY + ENTRY_DELAY, lockDelay = LOCK_DELAY, dropScore = 0;
-	uint16_t score = 0, start;
+	uint8_t held = 0, pushed, result, ticks;
+#ifdef OLED_EFFECTS
+	uint8_t flashDelay = 0;
+#endif
+	uint16_t count, start, tickTime;
+	int16_t remaining;
 #ifdef DEBUG_FPS
-	uint16_t fps = 0;
+	score_t fps = 0;
 #endif
 
 	matrix_init();
 	ssd1306_init();
-	timer0_init();
-	prng_init();
+	timer1_init();
+	// Read random seed from EEPROM
+	nvm_init();
+	game_init(nvRecord.seed);
 	setupScreen();
 #ifdef DOUBLE_BUFFER
 	ssd1306_switchFrame();
 	setupScreen();
 #endif
+	tickTime = millis();
 	while (1) {
 		start = millis();
+#ifdef DEBUG_PROFILE
+		phaseMark = micros();
+		phaseSkip = false;
+#endif
+		// Run the game logic at a fixed rate. Ticks are caught up without
+		// rendering when rendering took longer than a tick
+		ticks = 0;
+		do {
+			tickTime += TICK_TIME;
+#ifdef OLED_EFFECTS
+			// End line clear flash
+			if (flashDelay && --flashDelay == 0)
+				ssd1306_set_inverse(false);
+#endif
+			// Collect the buttons held and pushed since the last tick
+			pushed = getPushed(&held);
 #ifdef DEBUG_FPS
-		// Concurrent pushing of up and down button toggles displaying fps or score
-		if (buttonUp && buttonDown) {
-			showFps ^= true;
-			drawHeader();
+			// Concurrent pushing of up and down button cycles displaying score, fps
+			// and the phase readouts
+			if ((held & (BUTTON_UP | BUTTON_DOWN)) == (BUTTON_UP | BUTTON_DOWN)) {
+				if (++readout == READOUTS)
+					readout = READOUT_SCORE;
+				memset(drawnValue, 0xFF, sizeof(drawnValue));
+				drawHeader();
 #ifdef DOUBLE_BUFFER
-			ssd1306_switchFrame();
-			drawHeader();
+				ssd1306_switchFrame();
+				drawHeader();
 #endif
-			waitRelease();
-		}
+				waitRelease();
+				// The chord does not rotate or move the piece
+				held = pushed = 0;
+#ifdef DEBUG_PROFILE
+				phaseSkip = true;
 #endif
-		// Handle left button
-		if (buttonLeft) {
-			if (!collisionDetect(CD_LEFT) && (holdButtonLeft == 0 || holdButtonLeft >= SHIFT_DELAY))
-				pieceY--;
-			if (holdButtonLeft < SHIFT_DELAY)
-				holdButtonLeft++; // Delay auto repeat
-			else
-				holdButtonLeft--; // Skip one frame
-			prng();
-		}
-		if (!buttonLeft && holdButtonLeft)
-			holdButtonLeft = 0;
-		// Handle right button
-		if (buttonRight) {
-			if (!collisionDetect(CD_RIGHT) && (holdButtonRight == 0 || holdButtonRight >= SHIFT_DELAY))
-				pieceY++;
-			if (holdButtonRight < SHIFT_DELAY)
-				holdButtonRight++; // Delay auto repeat
-			else
-				holdButtonRight--; // Skip one frame
-			prng();
-		}
-		if (!buttonRight && holdButtonRight)
-			holdButtonRight = 0;
-		// Handle up button (rotate)
-		if (buttonUp && !holdButtonUp) {
-			holdButtonUp = true;
-			temp = rotate;
-			rotate = (rotate + 1) & 0x3;
-			// Restore previous rotation if there is no space to rotate
-			if (collisionDetect(CD_ROTATE))
-				rotate = temp;
-			prng();
-		}
-		if (!buttonUp && holdButtonUp)
-			holdButtonUp = false;
-		// Handle B button (hard drop)
-		if (buttonB && !holdButtonB) {
-			holdButtonB = true;
-			dropPiece = true;
-			prng();
-		}
-		if (!buttonB && holdButtonB)
-			holdButtonB = false;
-		// Handle A button (hold)
-		if (buttonA && mayHold) {
-			mayHold = false;
-			if (holdPiece == NO_PIECE) {
-				holdPiece = piece;
-				newPiece();
-			} else
-				swapPiece();
-			dropScore = 0;
-			prng();
-		}
-		// Handle down button (soft drop)
-		if (buttonDown && dropDelay > SOFT_DELAY) { 
-			dropDelay = SOFT_DELAY;
-			dropScore++;
-			prng();
-		}
-		// Check if piece can't drop further
-		if (collisionDetect(CD_DROP)) {
-			// Lock piece when timer expires or immediately when hard or soft dropping
-			if (lockDelay-- == 0 || dropPiece || dropDelay == SOFT_DELAY) {
-				lockDelay = LOCK_DELAY;
-				dropDelay = ENTRY_DELAY + DROP_DELAY - (level * (DROP_DELAY / 10));
-				mayHold = true;
-				dropPiece = false;
-				// Drop scoring
-				score += dropScore / 8;
-				dropScore = 0;
-				// Lock piece
-				collisionDetect(CD_LOCK);
-				// Spawn new piece and check if well is full
-				newPiece();
-				if (collisionDetect(CD_ROTATE)) {
-					scoreScreen(score);
-					sleepMode();
-					nextPiece = 0;
-					holdPiece = NO_PIECE;
-					score = 0;
-					level = 0;
-					lines = 0;
-				}
 			}
-		}
-		// Drop piece when timer expires or immediately when hard dropping
-		if (--dropDelay == 0 || dropPiece) {
-			dropDelay = DROP_DELAY - (level * (DROP_DELAY / 10));
-			if (dropPiece)
-				dropScore += 2;
-			pieceX--;
-		}
-		// Clear full lines and scoring system
-		if ((temp = clearLine())) {
-			lines += temp;
-			switch (temp) {
-				case 1: temp = 10; break;
-				case 2: temp = 30; break;
-				case 3: temp = 50; break;
-				default: temp = 80;
+#endif
+#ifdef DEBUG_PROFILE
+			profileMark(PHASE_INPUT);
+#endif
+			result = game_step(GAME_INPUT(held, pushed));
+#ifdef DIRTY_RENDER
+			if (result & GAME_LOCKED)
+				markRows(game.changedRow, result & GAME_CLEARED);
+#endif
+#ifdef DEBUG_PROFILE
+			profileMark(PHASE_LOGIC);
+#endif
+#ifdef OLED_EFFECTS
+			if (result & GAME_CLEARED) {
+				// Flash the screen by inverting the display
+				ssd1306_set_inverse(true);
+				flashDelay = FLASH_DELAY;
 			}
-			score += (temp * (level + 1));
-			level = lines / 10;
-			if (level > 9)
-				level = 9; 
-		}
-		// Draw screen except when hard dropping
-		if (!dropPiece) {
-			drawScreen();
-			// Display level and score
-			drawValue(104, 3, level);
-#ifdef DEBUG_FPS
-			drawValue(112, 0, (showFps) ? fps : score);
+#endif
+			if (result & GAME_OVER) {
+#ifdef OLED_EFFECTS
+				if (flashDelay) {
+					ssd1306_set_inverse(false);
+					flashDelay = 0;
+				}
+#endif
+				scoreScreen();
+				sleepMode();
+				game_restart();
+				held = 0;
+				// Start the next game from now instead of catching up the time slept
+				tickTime = millis();
+#ifdef DEBUG_PROFILE
+				phaseSkip = true;
+#endif
+			}
+		} while ((int16_t)(millis() - tickTime) >= 0 && ++ticks < MAX_TICKS);
+		// Skip the remaining ticks when too far behind
+		if ((int16_t)(millis() - tickTime) >= 0)
+			tickTime = millis();
+		// Draw screen
+		drawScreen();
+#ifdef DEBUG_PROFILE
+		profileMark(PHASE_DRAW);
+#endif
+		// Display level and score
+#ifdef DEBUG_PROFILE
+		drawValues(game.level, (readout > READOUT_FPS) ? profileValue() : (readout) ? fps : game.score);
+		profileMark(PHASE_HUD);
+#elif defined(DEBUG_FPS)
+		drawValues(game.level, (readout) ? fps : game.score);
 #else
-			drawValue(112, 0, score);
+		drawValues(game.level, game.score);
 #endif
 #ifdef DOUBLE_BUFFER
-			ssd1306_switchFrame();
+		ssd1306_switchFrame();
+#endif
+		ssd1306_flush();
+#ifdef DEBUG_PROFILE
+		profileMark(PHASE_SWITCH);
 #endif
-			// Scan button matrix
-			scanMatrix();
 #ifdef DEBUG_FPS
-			fps = 1000 / (millis() - start);
+		// Frames shorter than a millisecond count as one
+		start = millis() - start;
+#ifdef BCD_SCORE
+		fps = toBcd(1000 / ((start) ? start : 1));
+#else
+		fps = 1000 / ((start) ? start : 1);
 #endif
-			// Maintain 40 fps
-			while ((millis() - start) < 25);
+#endif
+		// Idle sleep until the next tick
+		while ((remaining = tickTime - millis()) > 0) {
+			// Compare match B wakes up at the tick when it is within this period
+			// of timer 1, a later tick is woken up by the end of the period. The
+			// flag of compare match B from an earlier period may wake up once
+			// before
+			count = (TCNT1 & 0xC0) + remaining * 64;
+			if (count <= TIMER1_TOP) {
+				OCR1B = count;
+				TIMSK |= _BV(OCIE1B);
+			}
+			sleep_mode();
 		}
+		TIMSK &= ~_BV(OCIE1B);
     }
 }
 
@@ -0,0 +1,115 @@
+/*
+ * Non volatile storage written in the background
+ *
+ * The queue holds spans of the EEPROM address, the SRAM source and the length
+ * of each block to write, so the source must not change until it is written.
+ * The EEPROM ready interrupt is enabled while the queue is not empty and fires
+ * whenever no write is in progress. The sequence numbers of the records from the
+ * first record up to the newest one are consecutive and the record after the
+ * newest one is a lap behind, so the newest record is the last one whose
+ * sequence number is its index past the sequence number of the first one.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <stdint.h>
+#include "nvm.h"
+
+#ifdef NVM_QUEUE
+// Spans queued for the interrupt, a power of 2
+#define QUEUE_MAX 4
+
+typedef struct {
+	uint8_t *dst;
+	const uint8_t *src;
+	uint8_t n;
+} span_t;
+
+volatile span_t queue[QUEUE_MAX];
+volatile uint8_t queueHead, queueTail;
+// Index of the newest record of the ring
+uint8_t nvIndex;
+#endif
+record_t nvRecord;
+// The first record is the newest one of a programmed EEPROM
+record_t EEMEM nvRing[NVM_RECORDS] = {{0, 1, 0}};
+
+#ifdef NVM_QUEUE
+
+// Read the newest record of the ring
+void nvm_init(void) {
+	uint8_t low = 0, high = NVM_RECORDS - 1, mid, first;
+	
+	first = eeprom_read_byte(&nvRing[0].sequence);
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if ((uint8_t)(eeprom_read_byte(&nvRing[mid].sequence) - first) == mid)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	nvIndex = low;
+	eeprom_read_block(&nvRecord, &nvRing[low], sizeof(nvRecord));
+}
+
+// Write nvRecord as the record after the newest one. The sequence number is
+// written last, so an interrupted write leaves the newest record as it was
+void nvm_save(void) {
+	nvIndex = (nvIndex + 1) & (NVM_RECORDS - 1);
+	nvRecord.sequence++;
+	nvm_write((uint8_t *)&nvRing[nvIndex] + 1, (uint8_t *)&nvRecord + 1, sizeof(nvRecord) - 1);
+	nvm_write(&nvRing[nvIndex].sequence, &nvRecord.sequence, 1);
+}
+
+// Queue a span of n bytes from src in SRAM to dst in EEPROM, waits only while
+// the queue is full
+void nvm_write(void *dst, const void *src, uint8_t n) {
+	uint8_t head = queueHead, next = (head + 1) & (QUEUE_MAX - 1);
+	
+	while (next == queueTail)
+		sleep_mode();	// Idle until the interrupt has finished a span
+	queue[head].dst = dst;
+	queue[head].src = src;
+	queue[head].n = n;
+	queueHead = next;
+	EECR |= _BV(EERIE);
+}
+
+// Wait until all queued bytes are written, the interrupt does not wake the
+// MCU from power down
+void nvm_flush(void) {
+	while (EECR & _BV(EERIE))
+		sleep_mode();	// Idle until the next interrupt
+}
+
+// Program the next queued byte that differs from the EEPROM and disable the
+// interrupt when the queue is empty
+ISR(EE_RDY_vect) {
+	uint8_t tail = queueTail, data;
+	volatile span_t *span;
+	
+	while (tail != queueHead) {
+		span = &queue[tail];
+		// A span leaves the queue after its last byte
+		if (!span->n) {
+			tail = (tail + 1) & (QUEUE_MAX - 1);
+			continue;
+		}
+		span->n--;
+		EEAR = (uintptr_t)span->dst++;
+		data = *span->src++;
+		EECR |= _BV(EERE);
+		if (EEDR != data) {
+			EEDR = data;
+			EECR = _BV(EERIE) | _BV(EEMPE);	// Erase and write mode
+			EECR |= _BV(EEPE);
+			queueTail = tail;
+			return;
+		}
+	}
+	queueTail = tail;
+	EECR = 0x00;
+}
+#endif
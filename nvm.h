@@ -0,0 +1,54 @@
+/*
+ * Non volatile storage written in the background
+ *
+ * With the NVM_QUEUE flag blocks of SRAM written to EEPROM are queued and
+ * programmed one byte at a time by the EEPROM ready interrupt, so the game does
+ * not wait 3.4 ms for each byte. A queued block must stay unchanged until it is
+ * written, see nvm_flush(). Bytes that are already stored are skipped. The
+ * random seed and the number of games change at every sleep, so they are kept
+ * in a ring of records that are written in turn, which spreads the wear over
+ * all records. The newest record is found at startup by a binary search of
+ * the sequence numbers. Without the flag the ring has a single record and
+ * writes wait for the EEPROM.
+ */
+
+
+#ifndef NVM_H_
+#define NVM_H_
+
+#include <avr/eeprom.h>
+#include <stdint.h>
+
+//#define NVM_QUEUE // Write from the EEPROM ready interrupt and wear level the seed
+
+// Records of the ring, a power of 2 at most 128
+#ifdef NVM_QUEUE
+#define NVM_RECORDS 16
+#else
+#define NVM_RECORDS 1
+#endif
+
+typedef struct {
+	// Sequence number of the record, one more than the record before it
+	uint8_t sequence;
+	uint16_t seed;
+	uint16_t games;
+} record_t;
+
+extern record_t EEMEM nvRing[NVM_RECORDS];
+// Copy of the newest record of the ring
+extern record_t nvRecord;
+
+#ifdef NVM_QUEUE
+extern void nvm_init(void);
+extern void nvm_save(void);
+extern void nvm_write(void *dst, const void *src, uint8_t n);
+extern void nvm_flush(void);
+#else
+#define nvm_init() eeprom_read_block(&nvRecord, nvRing, sizeof(nvRecord))
+#define nvm_save() eeprom_write_block(&nvRecord, nvRing, sizeof(nvRecord))
+#define nvm_write(dst, src, n) eeprom_write_block(src, dst, n)
+#define nvm_flush()
+#endif
+
+#endif /* NVM_H_ */
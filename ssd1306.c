@@ -232,10 +232,44 @@ const uint8_t ssd1306_init_sequence[] PROGMEM = {	// Initialization Sequence
 uint8_t oledX = 0, oledY = 0;
 uint8_t renderingFrame = 0xB0, drawingFrame = 0x40;
 
+#ifdef SSD1306_COMBINE
+// Open transaction, column and page of the controller address pointer and the
+// column start address that the column commands load into the pointer.
+// The parenthesized (i2c_write) and (i2c_stop) call the I2C routines directly
+enum {BUS_IDLE, BUS_COMMAND, BUS_CONTINUE, BUS_DATA};
+uint8_t busState = BUS_IDLE, busColumn, busStart, busPage = 0xFF;
+
+void ssd1306_write(uint8_t data) {
+	if (busState == BUS_DATA) {
+		busColumn++;	// Page addressing mode advances the column
+	} else {
+		if (busState == BUS_CONTINUE)
+			(i2c_write)(SSD1306_CONTINUE | SSD1306_COMMAND);
+		busPage = 0xFF;	// Unknown address pointer after a command
+	}
+	(i2c_write)(data);
+}
+
+void ssd1306_flush(void) {
+	if (busState != BUS_IDLE)
+		(i2c_stop)();
+	busState = BUS_IDLE;
+}
+
+void ssd1306_send_command_start(void) {
+	if (busState == BUS_COMMAND || busState == BUS_CONTINUE)
+		return;
+	ssd1306_flush();
+	i2c_start(SSD1306_ADDR + I2C_WRITE);
+	(i2c_write)(SSD1306_COMMAND);
+	busState = BUS_COMMAND;
+}
+#else
 void ssd1306_send_command_start(void) {
 	i2c_start(SSD1306_ADDR + I2C_WRITE);
 	i2c_write(SSD1306_COMMAND);
 }
+#endif
 
 void ssd1306_init(void) {
 	ssd1306_send_command_start();
@@ -257,11 +291,55 @@ void ssd1306_send_command(uint8_t command) {
 }
 
 void ssd1306_send_data_start(void) {
+#ifdef SSD1306_COMBINE
+	// Continue data stream or switch from single commands to data
+	if (busState == BUS_DATA)
+		return;
+	if (busState != BUS_CONTINUE) {
+		ssd1306_flush();
+		i2c_start(SSD1306_ADDR + I2C_WRITE);
+	}
+	(i2c_write)(SSD1306_DATA);
+	busState = BUS_DATA;
+#else
 	i2c_start(SSD1306_ADDR + I2C_WRITE);
 	i2c_write(SSD1306_DATA);
+#endif
 }
 
 void ssd1306_set_cursor(uint8_t x, uint8_t y) {
+#ifdef SSD1306_COMBINE
+	uint8_t page = renderingFrame | (y & 0x07), last = busPage, diff = 0xFF, n = 3;
+	
+	oledX = x;
+	oledY = y;
+	// Count commands needed to move the known address pointer. Either column
+	// command loads the whole start address, so the low nibble is always sent
+	// and the high nibble when it differs from the start address
+	if (last != 0xFF) {
+		diff = (x == busColumn) ? 0 : (x ^ busStart) | 0x0F;
+		n = (page != last) + ((diff & 0xF0) != 0) + ((diff & 0x0F) != 0);
+		if (n == 0)
+			return;
+	}
+	// Up to two single commands and the data that follows fit in one transaction
+	if (busState != BUS_COMMAND && n <= 2) {
+		ssd1306_flush();
+		i2c_start(SSD1306_ADDR + I2C_WRITE);
+		busState = BUS_CONTINUE;
+	}
+	ssd1306_send_command_start();
+	if (page != last)
+		i2c_write(page);
+	if (diff & 0xF0)
+		i2c_write(0x10 | ((x & 0xf0) >> 4));
+	if (diff & 0x0F) {
+		i2c_write(x & 0x0f);
+		busStart = x;
+	}
+	busColumn = x;
+	busPage = page;
+#else
 	ssd1306_send_command_start();
 	i2c_write(renderingFrame | (y & 0x07));
 	i2c_write(0x10 | ((x & 0xf0) >> 4));
@@ -269,6 +347,7 @@ void ssd1306_set_cursor(uint8_t x, uint8_t y) {
 	i2c_stop();
 	oledX = x;
 	oledY = y;
+#endif
 }
 
 void ssd1306_fill_length(uint8_t fill, uint8_t length) {
@@ -17,6 +17,21 @@
 #define SSD1306_COMMAND 0x00
 #define SSD1306_DATA 0x40
 #define SSD1306_ADDR (0x3C*2)	// Slave address
+#define SSD1306_CONTINUE 0x80	// Control byte continuation bit
+
+//#define SSD1306_COMBINE // Merge consecutive transactions and skip redundant cursor commands
+
+#ifdef SSD1306_COMBINE
+extern void ssd1306_write(uint8_t data);
+extern void ssd1306_flush(void);
+// Route the byte writes of all callers through the combining layer. A stop
+// is deferred until the next transaction needs a different start or until
+// ssd1306_flush() is called
+#define i2c_write(data) ssd1306_write(data)
+#define i2c_stop() do {} while (0)
+#else
+#define ssd1306_flush() do {} while (0)
+#endif
 
 extern void ssd1306_send_command_start(void);
 extern void ssd1306_init(void);
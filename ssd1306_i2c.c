@@ -1,12 +1,143 @@
 /*
- * Bit-bang I2C routines for SSD1306 controller driver
+ * Bit-bang or USI I2C routines for SSD1306 controller driver
  *
  * Created: 26-9-2018 08:51:43
  *  Author: Tim Dorssers
+ *
+ * All transfers are synchronous. The USI of the ATtiny45 has no clock
+ * generator for two-wire master mode and no timer output is on the SCL pin,
+ * so every SCL edge needs a write by the CPU. An interrupt driven transfer
+ * would take an interrupt for every edge or byte and run in the same cycles
+ * as the game logic, costing more than the cycle counted bit-bang instead of
+ * overlapping with it.
  */ 
 
 #include "ssd1306_i2c.h"
 
+#ifdef I2C_USI
+
+// Clock bits out of the USI data register until the counter overflows
+static void i2c_transfer(uint8_t status) {
+	USISR = status;
+	do {
+		_delay_us(I2C_USI_LOW);
+		USICR = I2C_USI_STROBE; // Positive SCL edge, the SSD1306 does not stretch the clock
+		_delay_us(I2C_USI_HIGH);
+		USICR = I2C_USI_STROBE; // Negative SCL edge
+	} while (!(USISR & _BV(USIOIF)));
+	USIDR = 0xFF; // Release SDA
+}
+
+void i2c_write(uint8_t data) {
+	USIDR = data;
+	i2c_transfer(I2C_USI_8BIT);
+	// ACK
+	DDR_REG &= ~(1 << SDA);
+	i2c_transfer(I2C_USI_1BIT);
+	DDR_REG |= (1 << SDA);
+}
+
+void i2c_start(uint8_t addr) {
+	// Enable two-wire mode with both lines released
+	USIDR = 0xFF;
+	USICR = I2C_USI_STROBE & ~_BV(USITC);
+	USISR = I2C_USI_8BIT;
+	// Single bit writes, the button matrix on the same port is scanned from an interrupt
+	PORT_REG |= (1 << SDA);
+	PORT_REG |= (1 << SCL);
+	DDR_REG |= (1 << SDA);
+	DDR_REG |= (1 << SCL);
+	_delay_us(I2C_USI_LOW);
+	PORT_REG &= ~(1 << SDA);   // SDA LOW while SCL is HIGH
+	_delay_us(I2C_START_STOP_DELAY);
+	PORT_REG &= ~(1 << SCL);   // SCL LOW
+	PORT_REG |= (1 << SDA);    // Hand SDA over to the data register
+	i2c_write(addr);
+}
+
+void i2c_stop(void) {
+	PORT_REG &= ~(1 << SDA);   // Set to LOW
+	PORT_REG |= (1 << SCL);    // Set to HIGH
+	_delay_us(I2C_START_STOP_DELAY);
+	PORT_REG |= (1 << SDA);    // Set to HIGH
+	_delay_us(I2C_IDLE_TIME);
+}
+
+#elif defined(I2C_FAST)
+
+// Busy wait an exact number of cycles inside an assembler block
+#define I2C_DELAY(n) ".rept (" n ") / 2\n\trjmp .+0\n\t.endr\n\t.rept (" n ") %% 2\n\tnop\n\t.endr\n\t"
+
+// Send one bit from the top of data in 10 cycles plus delays, without branches
+#define I2C_BIT I2C_DATA I2C_PULSE
+#define I2C_DATA \
+	"sbrc %[data], 7\n\t"    /* 5 cycles for either value of the bit */ \
+	"sbi %[port], %[sda]\n\t" \
+	"sbrs %[data], 7\n\t" \
+	"cbi %[port], %[sda]\n\t"
+#define I2C_PULSE \
+	"lsl %[data]\n\t" \
+	"sbi %[port], %[scl]\n\t" \
+	I2C_DELAY("%[high]") \
+	"cbi %[port], %[scl]\n\t"
+
+// Both lines are driven push-pull, the SSD1306 does not stretch the clock.
+// SDA is released for the ACK bit, which is not checked, and driven again
+// once the first bit of the next byte is on the port, as the SSD1306 may hold
+// the ACK for a while after SCL falls. A byte takes exactly 9 * I2C_BIT_CYCLES
+// cycles plus the call overhead
+void i2c_write(uint8_t data) {
+	__asm__ __volatile__ (
+		I2C_DATA
+		"sbi %[ddr], %[sda]\n\t"
+		I2C_PULSE
+		I2C_DELAY("%[low]")
+		".rept 6\n\t"
+		I2C_BIT
+		I2C_DELAY("%[low]")
+		".endr\n\t"
+		I2C_BIT
+		"cbi %[ddr], %[sda]\n\t"    // Release SDA as soon as SCL is low
+		I2C_DELAY("%[low] - 2")
+		// ACK
+		I2C_DELAY("6")
+		"sbi %[port], %[scl]\n\t"
+		I2C_DELAY("%[high]")
+		"cbi %[port], %[scl]\n\t"
+		I2C_DELAY("%[low] - 2")     // The next byte drives SDA 2 cycles later
+		: [data] "+r" (data)
+		: [port] "I" (_SFR_IO_ADDR(PORT_REG)), [ddr] "I" (_SFR_IO_ADDR(DDR_REG)),
+		  [sda] "I" (SDA), [scl] "I" (SCL),
+		  [high] "n" (I2C_HIGH_CYCLES), [low] "n" (I2C_LOW_CYCLES)
+	);
+}
+
+void i2c_start(uint8_t addr) {
+	PORT_REG |= (1 << SDA);              // Drive both lines HIGH, one bit at a
+	PORT_REG |= (1 << SCL);              // time as the button matrix on the same
+	DDR_REG |= (1 << SDA);               // port is scanned from an interrupt
+	DDR_REG |= (1 << SCL);
+	PORT_REG &= ~(1 << SDA);             // Set to LOW
+	__builtin_avr_delay_cycles(I2C_HIGH_CYCLES + 2);
+	PORT_REG &= ~(1 << SCL);             // Set to LOW
+	__builtin_avr_delay_cycles(I2C_LOW_CYCLES);
+	i2c_write(addr);
+}
+
+void i2c_stop(void) {
+	PORT_REG &= ~(1 << SDA);             // Set to LOW
+	DDR_REG |= (1 << SDA);               // Drive SDA again after the ACK
+	PORT_REG |= (1 << SCL);              // Set to HIGH
+	__builtin_avr_delay_cycles(I2C_HIGH_CYCLES + 2);
+	PORT_REG |= (1 << SDA);              // Set to HIGH
+	__builtin_avr_delay_cycles(I2C_LOW_CYCLES + 8);
+	// Release both lines to the pull-ups while idle
+	I2C_HIGH(DDR_REG, PORT_REG, SDA);
+	I2C_HIGH(DDR_REG, PORT_REG, SCL);
+}
+
+#else
+
 void i2c_write(uint8_t data) {
 	uint8_t i;
 	
@@ -47,3 +178,5 @@ void i2c_stop(void) {
 	I2C_HIGH(DDR_REG, PORT_REG, SDA);	// Set to HIGH
 	_delay_us(I2C_IDLE_TIME);
 }
+
+#endif
\ No newline at end of file
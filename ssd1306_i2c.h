@@ -1,5 +1,5 @@
 /*
- * Bit-bang I2C routines for SSD1306 controller driver
+ * Bit-bang or USI I2C routines for SSD1306 controller driver
  *
  * Created: 26-9-2018 08:52:01
  *  Author: Tim Dorssers
@@ -21,6 +21,9 @@
 
 #define I2C_WRITE 0
 
+//#define I2C_USI       // Use the USI in two-wire mode instead of bit-banging
+//#define I2C_FAST 1000 // Cycle counted push-pull bit-bang at 400, 800 or 1000 kHz
+
 // I2C HIGH = PORT as INPUT(0) and PULL-UP ENABLE (1)
 #define I2C_HIGH(DREG, PREG, BIT) { DREG &= ~(1 << BIT); PREG |= (1 << BIT); }
 
@@ -34,6 +37,32 @@
 #define I2C_IDLE_TIME        1.300
 #define I2C_CLOCK            2.500
 #define I2C_HALF_CLOCK       ((I2C_CLOCK - I2C_FALL_TIME - I2C_RISE_TIME - I2C_FALL_TIME) / 2)
+#define I2C_USI_LOW          1.300 // Fast mode SCL low period
+#define I2C_USI_HIGH         0.600 // Fast mode SCL high period
+
+// USI two-wire mode, software clock strobe and toggle SCL
+#define I2C_USI_STROBE (_BV(USIWM1) | _BV(USICS1) | _BV(USICLK) | _BV(USITC))
+// Clear USI flags and preset counter to overflow after 16 (8 bits) or 2 (1 bit) edges
+#define I2C_USI_8BIT   (_BV(USISIF) | _BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | 0x0)
+#define I2C_USI_1BIT   (_BV(USISIF) | _BV(USIOIF) | _BV(USIPF) | _BV(USIDC) | 0xE)
+
+// Cycles spent in the SCL high and low delays of the cycle counted bit-bang.
+// A bit takes 10 cycles of instructions plus both delays. SCL is high for
+// 2 + I2C_HIGH_CYCLES and low for 8 + I2C_LOW_CYCLES cycles. Speeds above
+// 400 kHz are beyond the SSD1306 datasheet and use fast mode plus timing
+#if I2C_FAST == 400
+#define I2C_HIGH_CYCLES 10 // 0.75 us high, 1.75 us low
+#define I2C_LOW_CYCLES  20
+#elif I2C_FAST == 800
+#define I2C_HIGH_CYCLES 4  // 0.375 us high, 0.875 us low
+#define I2C_LOW_CYCLES  6
+#elif I2C_FAST == 1000
+#define I2C_HIGH_CYCLES 3  // 0.3125 us high, 0.6875 us low
+#define I2C_LOW_CYCLES  3
+#elif defined(I2C_FAST)
+#error "I2C_FAST must be 400, 800 or 1000"
+#endif
+#define I2C_BIT_CYCLES (10 + I2C_HIGH_CYCLES + I2C_LOW_CYCLES)
 
 extern void i2c_stop(void);
 extern void i2c_start(uint8_t addr);
@@ -0,0 +1,394 @@
+/*
+ * Game logic of Tetris, independent of the screen and the buttons
+ *
+ * A tick handles the pushed buttons, auto shift, hold and soft drop and then
+ * drops, locks and spawns pieces on the timers of the game. Locked pieces and
+ * cleared lines are reported with changedRow for the renderer. All state is in
+ * G, which is the global game or the game passed with GAME_REENTRANT.
+ */
+
+#include <avr/pgmspace.h>
+#include <string.h>
+#include "tetris.h"
+
+#ifdef GAME_REENTRANT
+#define G (*g)
+#else
+#define G game
+game_t game;
+#endif
+
+const uint16_t PROGMEM pieces[] = {
+	0xF00, 0x4444, 0xF0, 0x2222, // I
+	0x170, 0x622, 0x74, 0x223,   // J
+	0x470, 0x226, 0x71, 0x322,   // L
+	0x660, 0x660, 0x660, 0x660,  // O
+	0x630, 0x264, 0x63, 0x132,   // S
+	0x270, 0x262, 0x72, 0x232,   // T
+	0x360, 0x462, 0x36, 0x231    // Z
+};
+#ifdef SRS_KICKS
+// Super Rotation System wall kicks of the J, L, S, T, Z pieces and of the I
+// piece, tested in order after the unkicked rotation. Each offset holds the
+// column to the right in the high nibble and the row up in the low nibble.
+// Only clock wise rotations from states 0, R, 2 and L are stored, the counter
+// clock wise kicks are the negated kicks of the reverse rotation
+#define KICK(y, x) (((y) & 0xF) << 4 | ((x) & 0xF))
+const uint8_t PROGMEM kicks[2][4][4] = {
+	{
+		{KICK(-1, 0), KICK(-1, 1), KICK(0, -2), KICK(-1, -2)}, // 0->R
+		{KICK(1, 0), KICK(1, -1), KICK(0, 2), KICK(1, 2)},     // R->2
+		{KICK(1, 0), KICK(1, 1), KICK(0, -2), KICK(1, -2)},    // 2->L
+		{KICK(-1, 0), KICK(-1, -1), KICK(0, 2), KICK(-1, 2)}   // L->0
+	}, {
+		{KICK(-2, 0), KICK(1, 0), KICK(-2, -1), KICK(1, 2)},   // 0->R
+		{KICK(-1, 0), KICK(2, 0), KICK(-1, 2), KICK(2, -1)},   // R->2
+		{KICK(2, 0), KICK(-1, 0), KICK(2, 1), KICK(-1, -2)},   // 2->L
+		{KICK(1, 0), KICK(-2, 0), KICK(1, -2), KICK(-2, 1)}    // L->0
+	}
+};
+#endif
+
+// Points of clearing 1 to 4 lines, multiplied by the level plus one
+const uint8_t PROGMEM linePoints[] = {10, 30, 50, 80};
+
+// Prototypes
+static uint8_t clearLine(GAME_PARAMS int8_t x);
+static bool linesCollide(GAME_PARAMS const uint16_t *lines, int8_t x, int8_t dy);
+static uint16_t lfsr16_next(uint16_t n);
+static void newPiece(GAME_PARAM);
+static bool pieceGrounded(GAME_PARAM);
+static uint16_t prng(GAME_PARAM);
+static void rotatePiece(GAME_PARAMS uint8_t dir);
+static void shiftPiece(GAME_PARAM);
+static void startPiece(GAME_PARAMS uint8_t p);
+static void updatePiece(GAME_PARAM);
+
+// Expand the 4 lines of the current piece moved to its column
+void updatePiece(GAME_PARAM) {
+	uint8_t i;
+	uint16_t bits;
+	
+	bits = pgm_read_word(&pieces[G.piece * 4 + G.rotate]);
+	for (i = 0; i < 4; i++) {
+		G.pieceLines[i] = (bits & 0xF) << (G.pieceY + PIECE_MARGIN); // pieceY is between -4 and 8
+		bits >>= 4;
+	}
+	G.grounded = -1;
+}
+
+// Check if lines at row x moved dy columns are below the floor, outside the
+// walls or overlap blocks in the well
+bool linesCollide(GAME_PARAMS const uint16_t *lines, int8_t x, int8_t dy) {
+	uint8_t i;
+	uint16_t line;
+	
+	for (i = 0; i < 4; i++, x++) {
+		line = lines[i];
+		if (!line)
+			continue;
+		if (dy < 0)
+			line >>= -dy;
+		else
+			line <<= dy;
+		// Check if blocks are below the floor or outside the walls
+		if (x < 0 || line & WALLS)
+			return true;
+		// Check for overlapping blocks, rows above the well are empty
+		if (x < WELL_MAX && G.well[x] & line >> PIECE_MARGIN)
+			return true;
+	}
+	return false;
+}
+
+// Move piece one column in the direction of the last pushed left or right
+// button if possible
+void shiftPiece(GAME_PARAM) {
+	if (!linesCollide(GAME_ARGS G.pieceLines, G.pieceX, G.shift)) {
+		G.pieceY += G.shift;
+		updatePiece(GAME_ARG);
+	}
+}
+
+// Rotate clock wise (dir 1) or counter clock wise (dir 3). The lines of the
+// new rotation are expanded once and restored when it does not fit. With
+// SRS_KICKS the Super Rotation System kicks are tried, each kick only shifts
+// the lines, so at most 5 tests of 4 lines are done
+void rotatePiece(GAME_PARAMS uint8_t dir) {
+	uint8_t from = G.rotate;
+#ifdef SRS_KICKS
+	uint8_t i, kick;
+	int8_t dx = 0, dy = 0;
+#endif
+	
+	G.rotate = (from + dir) & 0x3;
+	updatePiece(GAME_ARG);
+#ifdef SRS_KICKS
+	for (i = 0; i < 5; i++) {
+		if (i > 0) {
+			kick = pgm_read_byte(&kicks[G.piece == 0][(dir == 1) ? from : G.rotate][i - 1]);
+			dy = (int8_t)kick >> 4;
+			dx = (int8_t)(kick << 4) >> 4;
+			if (dir != 1) {
+				dx = -dx;
+				dy = -dy;
+			}
+			// Pieces never fit outside columns -2 to 8 and the lines would overflow
+			if (G.pieceY + dy < -2 || G.pieceY + dy > 8)
+				continue;
+		}
+		if (!linesCollide(GAME_ARGS G.pieceLines, G.pieceX + dx, dy)) {
+			G.pieceX += dx;
+			G.pieceY += dy;
+			updatePiece(GAME_ARG);
+			return;
+		}
+	}
+#else
+	if (!linesCollide(GAME_ARGS G.pieceLines, G.pieceX, 0))
+		return;
+#endif
+	G.rotate = from;
+	updatePiece(GAME_ARG);
+}
+
+// Check below the piece only when the piece or the well has changed
+bool pieceGrounded(GAME_PARAM) {
+	if (G.grounded < 0)
+		G.grounded = linesCollide(GAME_ARGS G.pieceLines, G.pieceX - 1, 0);
+	return G.grounded;
+}
+
+// Clear rows of blocks that span entire playing field, only the 4 rows from row
+// x touched by the locked piece are checked from the top down, so the rows
+// moved down over a cleared row were checked before. Returns number of cleared
+// lines
+uint8_t clearLine(GAME_PARAMS int8_t x) {
+	uint8_t i, r, s = 0;
+	
+	for (i = 4; i-- > 0;) {
+		r = x + i;
+		// Check if all 10 bits are set, rows below the floor wrap to above the well
+		if (r < WELL_MAX && G.well[r] >= 0x3FF) {
+			// Clear line by shifting blocks down one row
+			for (; r < WELL_MAX - 1; r++)
+				G.well[r] = G.well[r + 1];
+			G.well[WELL_MAX - 1] = 0;
+			// Count cleared lines
+			s++;
+		}
+	}
+	return s;
+}
+
+// Galois Linear Feedback Shift Register
+uint16_t lfsr16_next(uint16_t n) {
+	return (n >> 1) ^ (-(n & 0x1) & 0xB400);
+}
+
+// Pseudo Random Number Generator
+uint16_t prng(GAME_PARAM) {
+	return (G.random_number = lfsr16_next(G.random_number));
+}
+
+// Put piece p at the top of the playing field
+void startPiece(GAME_PARAMS uint8_t p) {
+	G.piece = p;
+	G.pieceX = WELL_MAX - 3;
+	G.pieceY = 3;
+	G.rotate = 0;
+	updatePiece(GAME_ARG);
+}
+
+// Put next piece on playing field
+void newPiece(GAME_PARAM) {
+	startPiece(GAME_ARGS G.nextPiece);
+	// NES-like randomizer
+	G.nextPiece = prng(GAME_ARG) % 8;
+	if (G.nextPiece == 7 || G.nextPiece == G.piece) {
+		G.nextPiece = prng(GAME_ARG) % 7;
+	}
+}
+
+#ifdef BCD_SCORE
+// Add packed BCD value v to packed BCD number of 6 digits
+void bcdAdd(uint32_t *bcd, uint16_t v) {
+	uint8_t i, lo, hi, carry = 0, *p = (uint8_t *)bcd;
+	
+	for (i = 0; i < 3; i++) {
+		lo = (p[i] & 0xF) + (v & 0xF) + carry;
+		hi = (p[i] >> 4) + ((v >> 4) & 0xF);
+		if (lo > 9) {
+			lo -= 10;
+			hi++;
+		}
+		carry = hi > 9;
+		if (carry)
+			hi -= 10;
+		p[i] = hi << 4 | lo;
+		v >>= 8;
+	}
+}
+
+// Convert binary value below 10000 to packed BCD
+uint16_t toBcd(uint16_t v) {
+	uint8_t shift = 0;
+	uint16_t bcd = 0;
+	
+	do {
+		bcd |= (v % 10) << shift;
+		shift += 4;
+	} while (v /= 10);
+	return bcd;
+}
+
+// Convert packed BCD value to binary
+uint32_t bcdToBin(uint32_t bcd) {
+	uint8_t shift = 24;
+	uint32_t v = 0;
+	
+	do {
+		shift -= 4;
+		v = v * 10 + ((bcd >> shift) & 0xF);
+	} while (shift);
+	return v;
+}
+#endif
+
+// Start the game with the random seed, the global of the AVR starts zeroed
+void game_init(GAME_PARAMS uint16_t seed) {
+#ifdef GAME_REENTRANT
+	memset(g, 0, sizeof(game_t));
+#endif
+	G.holdPiece = NO_PIECE;
+	G.dropDelay = DROP_DELAY + ENTRY_DELAY;
+	G.lockDelay = LOCK_DELAY;
+	G.shift = -1;
+	G.mayHold = true;
+	G.random_number = seed;
+	newPiece(GAME_ARG);
+	newPiece(GAME_ARG);
+}
+
+// Empty the well and reset the score after a game over, the piece that did
+// not fit stays to start the next game. The screen is set up again by the
+// caller, so no rows are reported as changed
+void game_restart(GAME_PARAM) {
+	memset(G.well, 0, sizeof(G.well));
+	G.grounded = -1;
+	G.nextPiece = 0;
+	G.holdPiece = NO_PIECE;
+	G.score = 0;
+	G.level = 0;
+	G.lines = 0;
+}
+
+// Run the game logic of one tick with the input word of the buttons held and
+// pushed during the tick. Returns the GAME_ results of the tick
+uint8_t game_step(GAME_PARAMS uint16_t input) {
+	uint8_t held = input, pushed = input >> 8, i, temp, result = 0;
+	uint16_t points;
+	
+	// Any button adds to the randomness
+	if (held | pushed)
+		prng(GAME_ARG);
+	// Shift once on a pushed left or right button and auto shift after a delay
+	// from the push
+	if (pushed & (BUTTON_LEFT | BUTTON_RIGHT)) {
+		G.shift = (pushed & BUTTON_LEFT) ? -1 : 1;
+		shiftPiece(GAME_ARG);
+		G.shiftDelay = DAS_DELAY + 1;	// Also counted down in this tick
+	}
+	// Auto shift while the last pushed left or right button is held
+	if (held & ((G.shift < 0) ? BUTTON_LEFT : BUTTON_RIGHT) && --G.shiftDelay == 0) {
+		G.shiftDelay = ARR_DELAY;
+		shiftPiece(GAME_ARG);
+	}
+	// Handle up button (rotate)
+	if (pushed & BUTTON_UP)
+		rotatePiece(GAME_ARGS 1);
+	// Handle B button (hard drop)
+	if (pushed & BUTTON_B)
+		G.dropPiece = true;
+#ifdef ROTATE_CCW
+	// Handle A button (rotate counter clock wise)
+	if (pushed & BUTTON_A)
+		rotatePiece(GAME_ARGS 3);
+#else
+	// Handle A button (hold)
+	if (held & BUTTON_A && G.mayHold) {
+		G.mayHold = false;
+		temp = G.holdPiece;
+		G.holdPiece = G.piece;
+		if (temp == NO_PIECE)
+			newPiece(GAME_ARG);
+		else
+			startPiece(GAME_ARGS temp);
+		G.dropScore = 0;
+	}
+#endif
+	// Handle down button (soft drop)
+	if (held & BUTTON_DOWN && G.dropDelay > SOFT_DELAY) {
+		G.dropDelay = SOFT_DELAY;
+		G.dropScore++;
+	}
+	// Repeat until the piece locks when hard dropping
+	do {
+		// Check if piece can't drop further
+		if (pieceGrounded(GAME_ARG)) {
+			// Lock piece when timer expires or immediately when hard or soft dropping
+			if (G.lockDelay-- == 0 || G.dropPiece || G.dropDelay == SOFT_DELAY) {
+				G.lockDelay = LOCK_DELAY;
+				G.dropDelay = ENTRY_DELAY + DROP_DELAY - (G.level * (DROP_DELAY / 10));
+#ifndef ROTATE_CCW
+				G.mayHold = true;
+#endif
+				G.dropPiece = false;
+				// Drop scoring
+				points = G.dropScore / 8;
+				G.dropScore = 0;
+				// Store blocks in well array, rows below the floor wrap to above
+				// the well
+				for (i = 0; i < 4; i++) {
+					temp = G.pieceX + i;
+					if (temp < WELL_MAX)
+						G.well[temp] |= G.pieceLines[i] >> PIECE_MARGIN;
+				}
+				G.changedRow = (G.pieceX < 0) ? 0 : G.pieceX;
+				result |= GAME_LOCKED;
+				// Clear full lines and scoring system
+				if ((temp = clearLine(GAME_ARGS G.pieceX))) {
+					result |= GAME_CLEARED;
+					G.lines += temp;
+					points += pgm_read_byte(&linePoints[temp - 1]) * (G.level + 1);
+					G.level = G.lines / 10;
+					if (G.level > 9)
+						G.level = 9;
+				}
+#ifdef BCD_SCORE
+				bcdAdd(&G.score, toBcd(points));
+				if (G.score > SCORE_MAX)
+					G.score = SCORE_MAX;
+#else
+				// A carry out of the 16 bits stops the score
+				G.score += points;
+				if (G.score < points)
+					G.score = SCORE_MAX;
+#endif
+				// Spawn new piece and check if well is full
+				newPiece(GAME_ARG);
+				if (linesCollide(GAME_ARGS G.pieceLines, G.pieceX, 0))
+					return result | GAME_OVER;
+			}
+		}
+		// Drop piece when timer expires or immediately when hard dropping
+		if (--G.dropDelay == 0 || G.dropPiece) {
+			G.dropDelay = DROP_DELAY - (G.level * (DROP_DELAY / 10));
+			if (G.dropPiece)
+				G.dropScore += 2;
+			G.pieceX--;
+			G.grounded = -1;
+		}
+	} while (G.dropPiece);
+	return result;
+}
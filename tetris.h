@@ -0,0 +1,113 @@
+/*
+ * Game logic of Tetris, independent of the screen and the buttons
+ *
+ * The whole game is kept in a game_t and advanced one tick at a time by
+ * game_step() with a word of the buttons held and pushed during the tick.
+ * The AVR has a single global game, which is addressed directly by all
+ * functions. With GAME_REENTRANT each function takes the game to work on,
+ * so the host can run many games at once.
+ */
+
+
+#ifndef TETRIS_H_
+#define TETRIS_H_
+
+#include <avr/pgmspace.h>
+#include <avr/sfr_defs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+//#define ROTATE_CCW    // A button rotates counter clockwise instead of holding
+//#define SRS_KICKS     // Super Rotation System wall kicks when a rotation does not fit
+//#define BCD_SCORE     // Keep the score in packed BCD, which is drawn without division
+//#define GAME_REENTRANT // Pass the game to each function instead of using the global
+
+// Button bits
+#define BUTTON_LEFT    _BV(0)
+#define BUTTON_RIGHT   _BV(1)
+#define BUTTON_DOWN    _BV(2)
+#define BUTTON_UP      _BV(3)
+#define BUTTON_A       _BV(4)
+#define BUTTON_B       _BV(5)
+// Input word of a tick, buttons held in the low byte and pushed in the high byte
+#define GAME_INPUT(held, pushed) ((held) | (uint16_t)(pushed) << 8)
+// Play field is 10 bits wide and 30 rows tall
+#define WELL_MAX 30
+#define WELL_ROWS (~(~0UL << WELL_MAX))
+#define NO_PIECE 255
+// Lines of a piece have a margin of 4 bits on both sides of the 10 columns to
+// detect the walls
+#define PIECE_MARGIN 4
+#define WALLS        0xC00F
+// Delay in ticks
+#define DROP_DELAY  20
+#define LOCK_DELAY  20
+#define ENTRY_DELAY 20
+#define SOFT_DELAY  2
+// Delayed auto shift and auto repeat rate in ticks, counted from the push
+#define DAS_DELAY   10
+#define ARR_DELAY   2
+// Results of a tick
+#define GAME_CLEARED _BV(0) // Lines were cleared, rows from changedRow up moved
+#define GAME_OVER    _BV(1) // The new piece does not fit, see game_restart()
+#define GAME_LOCKED  _BV(2) // A piece was locked in the 4 rows from changedRow
+
+// The score stops at the highest value of 5 digits, which are drawn
+#ifdef BCD_SCORE
+typedef uint32_t score_t; // Packed BCD
+#define SCORE_MAX 0x99999UL
+#else
+typedef uint16_t score_t;
+#define SCORE_MAX 0xFFFF
+#endif
+
+typedef struct {
+	uint16_t well[WELL_MAX];
+	// Lowest row of the well changed by the last tick, see the GAME_ results
+	uint8_t changedRow;
+	// Current piece, next piece and hold piece
+	int8_t pieceX, pieceY;
+	uint8_t piece, rotate, nextPiece, holdPiece;
+	// Lines of the current piece
+	uint16_t pieceLines[4];
+	// Cached result of checking below the piece, -1 when the piece or well changed
+	int8_t grounded;
+	// Random number seed variable
+	uint16_t random_number;
+	// Score and progress
+	score_t score;
+	uint8_t level, lines;
+	// Timers in ticks and points of the soft or hard drop of the current piece
+	uint8_t dropDelay, lockDelay, shiftDelay, dropScore;
+	// Column step of the last pushed left or right button
+	int8_t shift;
+	bool dropPiece, mayHold;
+} game_t;
+
+// Parameters of the functions taking the game
+#ifdef GAME_REENTRANT
+#define GAME_PARAM  game_t *g
+#define GAME_PARAMS game_t *g,
+#define GAME_ARG    g
+#define GAME_ARGS   g,
+#else
+#define GAME_PARAM  void
+#define GAME_PARAMS
+#define GAME_ARG
+#define GAME_ARGS
+extern game_t game;
+#endif
+
+// Each piece is 4x4 bits and has 4 rotations
+extern const uint16_t PROGMEM pieces[];
+
+extern void game_init(GAME_PARAMS uint16_t seed);
+extern void game_restart(GAME_PARAM);
+extern uint8_t game_step(GAME_PARAMS uint16_t input);
+#ifdef BCD_SCORE
+extern void bcdAdd(uint32_t *bcd, uint16_t v);
+extern uint16_t toBcd(uint16_t v);
+extern uint32_t bcdToBin(uint32_t bcd);
+#endif
+
+#endif /* TETRIS_H_ */